@@ -0,0 +1,43 @@
+#ifndef TIDY_UTILS_COMMON_BLOOM_FILTER_HPP
+#define TIDY_UTILS_COMMON_BLOOM_FILTER_HPP
+
+// LLVM includes
+#include <llvm/ADT/StringRef.h>
+
+// Standard includes
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tidy {
+
+/// A Bloom filter of strings.
+///
+/// Answers whether a string may be in a set, with false positives at a rate of
+/// about 1% but never false negatives. It uses about ten bits per string, so a
+/// filter of all macro names of a large project stays cache resident.
+class BloomFilter {
+ public:
+  /// Creates an empty filter sized for `expectedSize` strings.
+  explicit BloomFilter(std::size_t expectedSize);
+
+  /// Adds `string` to the set.
+  void insert(llvm::StringRef string);
+
+  /// Returns false if `string` is certainly not in the set.
+  bool mayContain(llvm::StringRef string) const;
+
+ private:
+  /// The number of bits set per string.
+  static constexpr unsigned kHashes = 7;
+
+  /// The bits, `_mask + 1` of them.
+  std::vector<std::uint64_t> _bits;
+
+  /// The number of bits minus one; the number of bits is a power of two.
+  std::uint64_t _mask;
+};
+
+}  // namespace tidy
+
+#endif  // TIDY_UTILS_COMMON_BLOOM_FILTER_HPP
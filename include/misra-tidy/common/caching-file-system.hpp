@@ -0,0 +1,149 @@
+#ifndef TIDY_UTILS_COMMON_CACHING_FILE_SYSTEM_HPP
+#define TIDY_UTILS_COMMON_CACHING_FILE_SYSTEM_HPP
+
+// Clang includes
+#include <clang/Basic/VirtualFileSystem.h>
+
+// LLVM includes
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/ErrorOr.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+// Standard includes
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+class Twine;
+}
+
+namespace tidy {
+
+/// Run-wide, thread-safe cache of file system lookups.
+///
+/// Every translation unit stats the same include directories and reads the
+/// same headers. The `FileCache` remembers the result of each stat (including
+/// failed ones, which are the bulk of include directory probing), each
+/// directory listing and the contents of each file read, so the underlying
+/// file system is asked at most once per path and run. Contents are read into
+/// memory rather than mapped, since files may be rewritten during the run.
+///
+/// All paths passed to a `FileCache` must be absolute and normalized by
+/// `Routines::absoluteIn` (or `Routines::makeAbsolute`). Use it through a
+/// `CachingFileSystem`, which resolves relative paths.
+class FileCache {
+ public:
+  /// A directory entry: its name within the directory and its status.
+  using DirectoryEntry = std::pair<std::string, clang::vfs::Status>;
+
+  /// The entries of a directory.
+  using DirectoryListing = std::vector<DirectoryEntry>;
+
+  /// Creates a cache in front of `underlying`.
+  explicit FileCache(llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem> underlying =
+                         clang::vfs::getRealFileSystem());
+
+  /// Returns the status of `path`.
+  llvm::ErrorOr<clang::vfs::Status> status(const std::string& path);
+
+  /// Returns the contents of the file at `path`. The buffer is null-terminated.
+  llvm::ErrorOr<std::shared_ptr<const llvm::MemoryBuffer>> contents(
+      const std::string& path);
+
+  /// Returns the entries of the directory at `path`.
+  llvm::ErrorOr<std::shared_ptr<const DirectoryListing>> listing(
+      const std::string& path);
+
+  /// Forgets everything about `path` and the listing of its parent directory.
+  /// Must be called whenever `path` is written during the run.
+  void invalidate(llvm::StringRef path);
+
+  /// Replaces the contents of the file at `path` for the rest of the run,
+  /// without touching the underlying file system. The file need not exist,
+  /// though directory listings only show it if it does.
+  void replace(const std::string& path, llvm::StringRef contents);
+
+  /// Preloads the paths that did not exist in a previous run, as saved by
+  /// `saveMissingFiles()` to `filename`, so looking them up again costs
+  /// nothing. Missing paths are grouped by their closest existing directory
+  /// and only loaded if that directory's modification time is unchanged, since
+  /// creating anything below it would have changed it. Returns the number of
+  /// paths loaded; a missing or unreadable `filename` loads none.
+  std::size_t loadMissingFiles(const std::string& filename);
+
+  /// Saves every path found missing during this run to `filename`, for
+  /// `loadMissingFiles()`. Directories that changed during the run, or too
+  /// recently to tell a later change by their modification time, are left out.
+  void saveMissingFiles(const std::string& filename);
+
+ private:
+  /// A cached result of an operation that may fail.
+  template <typename T>
+  struct Cached {
+    std::error_code error;
+    T value;
+  };
+
+  /// The file system lookups are forwarded to.
+  llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem> _underlying;
+
+  /// Guards all maps below. Never held while accessing `_underlying`.
+  std::mutex _mutex;
+
+  /// The status of every path looked up so far.
+  llvm::StringMap<Cached<clang::vfs::Status>> _statuses;
+
+  /// The contents of every file read so far.
+  llvm::StringMap<Cached<std::shared_ptr<const llvm::MemoryBuffer>>> _contents;
+
+  /// The entries of every directory listed so far.
+  llvm::StringMap<Cached<std::shared_ptr<const DirectoryListing>>> _listings;
+};
+
+/// A `clang::vfs::FileSystem` answering from a shared `FileCache`.
+///
+/// Each translation unit gets its own `CachingFileSystem` (and with it its own
+/// `clang::FileManager` and working directory), while all of them share the
+/// same `FileCache`. Changing the working directory only affects how relative
+/// paths are resolved by this instance, never the process.
+class CachingFileSystem : public clang::vfs::FileSystem {
+ public:
+  /// Creates a file system resolving relative paths against
+  /// `workingDirectory`, which must be absolute.
+  CachingFileSystem(std::shared_ptr<FileCache> cache,
+                    std::string workingDirectory);
+
+  llvm::ErrorOr<clang::vfs::Status> status(const llvm::Twine& path) override;
+
+  llvm::ErrorOr<std::unique_ptr<clang::vfs::File>> openFileForRead(
+      const llvm::Twine& path) override;
+
+  clang::vfs::directory_iterator dir_begin(const llvm::Twine& directory,
+                                           std::error_code& error) override;
+
+  llvm::ErrorOr<std::string> getCurrentWorkingDirectory() const override;
+
+  std::error_code setCurrentWorkingDirectory(const llvm::Twine& path) override;
+
+ private:
+  /// Returns `path` made absolute against the working directory by
+  /// `Routines::absoluteIn`, which is how the `FileCache` keys it.
+  std::string _absolute(const llvm::Twine& path) const;
+
+  /// The shared cache.
+  std::shared_ptr<FileCache> _cache;
+
+  /// The directory relative paths are resolved against.
+  std::string _workingDirectory;
+};
+
+}  // namespace tidy
+
+#endif  // TIDY_UTILS_COMMON_CACHING_FILE_SYSTEM_HPP
@@ -0,0 +1,51 @@
+#ifndef TIDY_UTILS_COMMON_NAME_FILTER_HPP
+#define TIDY_UTILS_COMMON_NAME_FILTER_HPP
+
+// LLVM includes
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Regex.h>
+
+// Standard includes
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace tidy {
+
+/// Decides which macros a run may touch, by regular expressions on their
+/// names.
+///
+/// A name is accepted if it fully matches one of the allowed expressions (or
+/// there are none) and none of the skipped ones. Each list is compiled once
+/// into a single alternation. Answers are remembered per name, since the same
+/// headers define the same macros in every translation unit.
+class NameFilter {
+ public:
+  /// Compiles the expressions (POSIX extended syntax). Throws a
+  /// `Routines::ErrorCode` if one is invalid.
+  NameFilter(const std::vector<std::string>& allowed,
+             const std::vector<std::string>& skipped);
+
+  /// Returns true if the run may touch the macro `name`.
+  bool accepts(llvm::StringRef name);
+
+ private:
+  /// The alternation of the allowed expressions, if there are any.
+  llvm::Optional<llvm::Regex> _allowed;
+
+  /// The alternation of the skipped expressions, if there are any.
+  llvm::Optional<llvm::Regex> _skipped;
+
+  /// Guards `_answers`, since translation units are preprocessed in parallel.
+  /// Only held to look up or store an answer, never while matching.
+  std::mutex _mutex;
+
+  /// The answer for every name asked about so far.
+  llvm::StringMap<bool> _answers;
+};
+
+}  // namespace tidy
+
+#endif  // TIDY_UTILS_COMMON_NAME_FILTER_HPP
@@ -0,0 +1,41 @@
+#ifndef TIDY_UTILS_COMMON_PATH_FILTER_HPP
+#define TIDY_UTILS_COMMON_PATH_FILTER_HPP
+
+// LLVM includes
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/GlobPattern.h>
+
+// Standard includes
+#include <string>
+#include <vector>
+
+namespace tidy {
+
+/// Decides which files a run may touch, by glob patterns on their paths.
+///
+/// A path is accepted if it matches at least one include pattern (or there are
+/// none) and no exclude pattern. Patterns are compiled once, on construction;
+/// `*` also matches `/`, so `*/third_party/*` excludes a whole directory tree.
+class PathFilter {
+ public:
+  /// Compiles the patterns. Throws a `Routines::ErrorCode` if one is invalid.
+  PathFilter(const std::vector<std::string>& includePatterns,
+             const std::vector<std::string>& excludePatterns);
+
+  /// Returns true if there are no patterns, so every path is accepted.
+  bool isEmpty() const noexcept;
+
+  /// Returns true if the run may touch the file at the absolute `path`.
+  bool accepts(llvm::StringRef path) const;
+
+ private:
+  /// The compiled include patterns.
+  std::vector<llvm::GlobPattern> _includes;
+
+  /// The compiled exclude patterns.
+  std::vector<llvm::GlobPattern> _excludes;
+};
+
+}  // namespace tidy
+
+#endif  // TIDY_UTILS_COMMON_PATH_FILTER_HPP
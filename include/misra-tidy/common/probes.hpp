@@ -0,0 +1,90 @@
+#ifndef TIDY_UTILS_COMMON_PROBES_HPP
+#define TIDY_UTILS_COMMON_PROBES_HPP
+
+/// \file
+/// Static (USDT) tracepoints under the `macro_expand` provider.
+///
+/// When the build finds `<sys/sdt.h>` (see the `MACRO_EXPAND_USDT` cmake
+/// option), every `TIDY_PROBEn(name, ...)` becomes a `nop` in the binary that
+/// `perf`, `bpftrace` or SystemTap can attach to at runtime, for example:
+///
+/// ```
+/// bpftrace -e 'usdt:./macro-expand:macro_expand:tu__begin { printf("%s\n", str(arg0)); }'
+/// ```
+///
+/// Each probe has a semaphore, which the tracer increments while attached.
+/// The probe tests it first, so without a tracer it costs a load and a branch
+/// and its arguments are never evaluated. Otherwise the probes compile away
+/// entirely. Either way, arguments may be (moderately) expensive expressions.
+///
+/// Probes (with their arguments):
+///  - `tu__begin(file)`, `tu__end(file, failed)`
+///  - `macro__accept(macro, file, line)`, `macro__reject(macro, file, reason)`
+///  - `macro__defined(macro, file, line)`
+///  - `file__write(file, bytes)`
+///
+/// A new probe needs its semaphore declared below and defined in `probes.cpp`.
+
+#if defined(MACRO_EXPAND_USDT)
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+/// The semaphore of the probe `name`, named the way `<sys/sdt.h>` refers to it.
+#define TIDY_PROBE_SEMAPHORE(name) macro_expand_##name##_semaphore
+
+/// Declares the semaphore of the probe `name`, in the section tracers find
+/// it in.
+#define TIDY_DECLARE_PROBE(name) \
+  __extension__ extern unsigned short TIDY_PROBE_SEMAPHORE(name) \
+      __attribute__((unused)) __attribute__((section(".probes")))
+
+TIDY_DECLARE_PROBE(tu__begin);
+TIDY_DECLARE_PROBE(tu__end);
+TIDY_DECLARE_PROBE(macro__accept);
+TIDY_DECLARE_PROBE(macro__reject);
+TIDY_DECLARE_PROBE(macro__defined);
+TIDY_DECLARE_PROBE(file__write);
+
+/// Whether a tracer is attached to the probe `name`.
+#define TIDY_PROBE_ENABLED(name) __builtin_expect(TIDY_PROBE_SEMAPHORE(name) != 0, 0)
+
+#define TIDY_PROBE1(name, a) \
+  do { if (TIDY_PROBE_ENABLED(name)) DTRACE_PROBE1(macro_expand, name, a); } while (false)
+#define TIDY_PROBE2(name, a, b) \
+  do { if (TIDY_PROBE_ENABLED(name)) DTRACE_PROBE2(macro_expand, name, a, b); } while (false)
+#define TIDY_PROBE3(name, a, b, c) \
+  do { if (TIDY_PROBE_ENABLED(name)) DTRACE_PROBE3(macro_expand, name, a, b, c); } while (false)
+#else
+#define TIDY_PROBE_ENABLED(name) false
+#define TIDY_PROBE1(name, a) ((void)0)
+#define TIDY_PROBE2(name, a, b) ((void)0)
+#define TIDY_PROBE3(name, a, b, c) ((void)0)
+#endif
+
+namespace tidy {
+namespace Probes {
+
+/// Why `MacroSearch::MacroExpands` did not expand a macro, as passed to the
+/// `macro__reject` probe.
+enum RejectReason : int {
+  /// The definition is not one we track (system header, command line, ...).
+  kUntracked = 1,
+
+  /// The definition or the call site is in a system or unwritable file.
+  kNotRewritable = 2,
+
+  /// Expansion of this kind of macro (object- or function-like) is disabled.
+  kKindDisabled = 3,
+
+  /// The call site is in a file excluded by the path filters.
+  kFiltered = 4,
+
+  /// The call site is outside the lines changed since `-since`, with
+  /// `-changed-lines-only`.
+  kUnchanged = 5,
+};
+
+}  // namespace Probes
+}  // namespace tidy
+
+#endif  // TIDY_UTILS_COMMON_PROBES_HPP
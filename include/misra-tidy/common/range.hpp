@@ -8,6 +8,9 @@
 // Third party includes
 #include <third-party/json.hpp>
 
+// Standard includes
+#include <string>
+
 namespace clang {
 class SourceManager;
 class SourceRange;
@@ -22,6 +25,9 @@ struct Range {
   Range(const clang::SourceRange& range,
         const clang::SourceManager& sourceManager);
 
+  /// Constructs a range of `filename` from its start and end `Offset`s.
+  Range(std::string filename_, Offset begin_, Offset end_);
+
   /// Converts the `Range` to JSON.
   nlohmann::json toJson() const;
 
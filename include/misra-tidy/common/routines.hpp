@@ -3,6 +3,7 @@
 #define TIDY_UTILS_COMMON_ROUTINES_HPP
 
 // Standard includes
+#include <cstddef>
 #include <string>
 
 namespace clang {
@@ -11,6 +12,7 @@ namespace clang {
     class LangOptions;
     class SourceRange;
     class ASTContext;
+    class MacroInfo;
 }
 
 namespace llvm {
@@ -38,9 +40,28 @@ namespace tidy {
         std::string getSourceText(const clang::SourceRange& range,
             clang::ASTContext& context);
 
-        /// Turns a file path into an absolute file path.
+        /// Gets the raw source text of a macro definition (its replacement list).
+        std::string getDefinitionText(const clang::MacroInfo& info,
+            clang::SourceManager& sourceManager,
+            const clang::LangOptions& languageOptions);
+
+        /// Returns `filename` made absolute against `directory`, which must be
+        /// absolute, without `.` and `..` components. Every path that keys the
+        /// file cache goes through here, so all spellings of a file agree.
+        std::string absoluteIn(const std::string& directory, const std::string& filename);
+
+        /// Turns a file path into an absolute file path, like `absoluteIn` with
+        /// the working directory.
         std::string makeAbsolute(const std::string& filename);
 
+        /// Returns `filename` relative to the working directory if it lies below
+        /// it, so checkouts in different places agree, or else as it is.
+        std::string makeRelative(const std::string& filename);
+
+        /// Returns the peak resident set size of the process in bytes, or zero if
+        /// the platform does not report it.
+        std::size_t peakResidentBytes();
+
         /// Prints an error message to stderr and exits. the program.
         [[noreturn]] void error(const char* message);
 
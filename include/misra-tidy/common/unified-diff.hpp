@@ -0,0 +1,29 @@
+#ifndef TIDY_UTILS_COMMON_UNIFIED_DIFF_HPP
+#define TIDY_UTILS_COMMON_UNIFIED_DIFF_HPP
+
+// LLVM includes
+#include <llvm/ADT/StringRef.h>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace tidy {
+
+/// Writes the changes from `before` to `after`, the old and new contents of
+/// the file `name`, to `out` as a unified diff with `context` lines of context
+/// that `patch -p1` and `git apply` understand. Writes nothing if the contents
+/// are equal.
+///
+/// Lines are compared with Myers' algorithm after stripping the lines both
+/// versions start and end with, so the cost grows with the size of the change
+/// rather than with the size of the file.
+void writeUnifiedDiff(llvm::raw_ostream& out,
+                      llvm::StringRef name,
+                      llvm::StringRef before,
+                      llvm::StringRef after,
+                      unsigned context = 3);
+
+}  // namespace tidy
+
+#endif  // TIDY_UTILS_COMMON_UNIFIED_DIFF_HPP
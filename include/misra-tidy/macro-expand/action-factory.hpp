@@ -7,6 +7,7 @@
 
 namespace tidy {
     struct Query;
+    struct UnitRecords;
 }
 
 namespace tidy {
@@ -20,17 +21,20 @@ namespace tidy {
         /// does not allow passing parameters to an action.
         class ActionFactory : public clang::tooling::FrontendActionFactory {
         public:
-            /// Constructor, taking the location the user invoked macro-expand with and
-            /// the fresh `Query` object.
-            explicit ActionFactory(Query& query);
+            /// Constructor, taking the ongoing `Query` object and the `UnitRecords`
+            /// of the translation unit the actions run on.
+            ActionFactory(Query& query, UnitRecords& records);
 
             /// Creates the action of the symbol search phase.
             /// \returns A `MacroExpand::Action`.
             clang::FrontendAction* create() override;
 
         private:
-            /// The newly created `Query` object.
+            /// The ongoing `Query` object.
             Query& _query;
+
+            /// What the translation unit found.
+            UnitRecords& _records;
         };
     }  // namespace MacroExpand
 }  // namespace tidy
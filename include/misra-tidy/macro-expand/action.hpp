@@ -3,11 +3,15 @@
 
 // Project includes
 #include "misra-tidy/common/location.hpp"
+#include "misra-tidy/macro-expand/token-cache.hpp"
 
 // Clang includes
 #include <clang/Basic/SourceLocation.h>
 #include "clang/Frontend/FrontendActions.h"
 
+// LLVM includes
+#include <llvm/ADT/Optional.h>
+
 // Standard includes
 #include <memory>
 #include <string>
@@ -23,6 +27,7 @@ class StringRef;
 
 namespace tidy {
 struct Query;
+struct UnitRecords;
 }
 
 namespace tidy {
@@ -40,11 +45,12 @@ class Action : public clang::PreprocessOnlyAction {
   using super = clang::ASTFrontendAction;
   using ASTConsumerPointer = std::unique_ptr<clang::ASTConsumer>;
 
-  /// Constructor, taking the location at which to look for a function call and
-  /// the ongoing `Query` object.
-  Action(Query& query) : _query(query) {}
+  /// Constructor, taking the ongoing `Query` object and the `UnitRecords` the
+  /// translation unit records into.
+  Action(Query& query, UnitRecords& records)
+  : _query(query), _records(records) {}
 
-  /// Called before any file is even touched. Allows us to register a rewriter.
+  /// Called before any file is even touched. Looks up the token cache entry.
   bool BeginInvocation(clang::CompilerInstance& Compiler) override;
 
   /// Attempts to translate the `targetLocation` to a `clang::SourceLocation`
@@ -52,11 +58,24 @@ class Action : public clang::PreprocessOnlyAction {
   bool BeginSourceFileAction(clang::CompilerInstance& compiler,
                              llvm::StringRef filename) override;
 
+  /// Preprocesses the file. If the query has a token cache without a valid
+  /// entry for this translation unit, preprocessing also writes that entry.
+  void ExecuteAction() override;
+
   void EndSourceFileAction() override;
 
  private:
   /// The ongoing `Query` object.
   Query& _query;
+
+  /// What the translation unit found.
+  UnitRecords& _records;
+
+  /// The token cache entry this action writes, if the cache had no valid one.
+  llvm::Optional<TokenCache::Entry> _staleTokenCache;
+
+  /// The temporary file the tokens for `_staleTokenCache` are written to.
+  std::string _temporaryTokens;
 };
 
 }  // namespace MacroExpand
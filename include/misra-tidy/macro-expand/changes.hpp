@@ -0,0 +1,51 @@
+#ifndef MACRO_EXPAND_CHANGES_HPP
+#define MACRO_EXPAND_CHANGES_HPP
+
+// LLVM includes
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+
+// Standard includes
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tidy {
+
+/// The files, and lines within them, changed in a git work tree.
+class Changes {
+ public:
+  /// An inclusive range of changed lines.
+  using LineRange = std::pair<unsigned, unsigned>;
+
+  /// Reads the changes of the work tree (staged or not) relative to
+  /// `revision`, by running `git diff` in the current directory. Throws a
+  /// `Routines::ErrorCode` if git fails.
+  static Changes fromGit(const std::string& revision);
+
+  /// Parses the output of `git diff --unified=0` with paths relative to
+  /// `root`. Exposed for the benefit of `fromGit()`.
+  static Changes fromDiff(llvm::StringRef diff, llvm::StringRef root);
+
+  /// Returns the changes of the absolute `paths`, without line information.
+  static Changes fromFiles(const std::vector<std::string>& paths);
+
+  /// Returns true if the file at the absolute `path` changed (including if it
+  /// was deleted or renamed).
+  bool containsFile(llvm::StringRef path) const;
+
+  /// Returns the changed line ranges of the file at the absolute `path`, or
+  /// null if it did not change.
+  const std::vector<LineRange>* linesOf(llvm::StringRef path) const;
+
+  /// The git directory of the work tree, when read by `fromGit()`.
+  std::string gitDirectory;
+
+ private:
+  /// The changed line ranges of every changed file, in ascending order.
+  llvm::StringMap<std::vector<LineRange>> _files;
+};
+
+}  // namespace tidy
+
+#endif  // MACRO_EXPAND_CHANGES_HPP
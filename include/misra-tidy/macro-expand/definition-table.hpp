@@ -0,0 +1,102 @@
+#ifndef MACRO_EXPAND_DEFINITION_TABLE_HPP
+#define MACRO_EXPAND_DEFINITION_TABLE_HPP
+
+// Project includes
+#include "misra-tidy/common/location.hpp"
+
+// Clang includes
+#include <clang/Basic/SourceLocation.h>
+
+// LLVM includes
+#include <llvm/ADT/BitVector.h>
+#include <llvm/Support/FileSystem.h>
+
+// Standard includes
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace clang {
+class SourceManager;
+}
+
+namespace tidy {
+
+/// The macro definitions in headers seen by any translation unit, and which of
+/// them any translation unit used.
+///
+/// Each definition gets a dense ID the first time a translation unit sees it,
+/// keyed by the unique ID of its file and its offset in it, so looking it up
+/// again costs no string hashing or line computation. A translation unit
+/// records the definitions it used in a `llvm::BitVector` indexed by ID and
+/// merges it with `markUsed()`, a word-wide OR. A definition is unused once no
+/// translation unit has marked it.
+///
+/// All members are safe to call from several threads.
+class DefinitionTable {
+ public:
+  /// The ID returned for definitions without a file.
+  static constexpr unsigned kInvalid = ~0u;
+
+  /// Returns the ID of the definition at `location`, adding it if new, or
+  /// `kInvalid` if it is not in a file.
+  unsigned idOf(clang::SourceLocation location,
+                const clang::SourceManager& sourceManager);
+
+  /// Adds the definition at `location` without a file identity, e.g. as read
+  /// back from the output of a sharded run or a journal, and returns its ID.
+  /// Adding the same location again, or a translation unit seeing the
+  /// definition later, returns the same ID.
+  unsigned add(Location location);
+
+  /// Marks the definitions whose bits are set in `used` as used.
+  void markUsed(const llvm::BitVector& used);
+
+  /// Marks the definition `id` as used.
+  void markUsed(unsigned id);
+
+  /// Returns true if some translation unit used the definition `id`.
+  bool isUsed(unsigned id) const;
+
+  /// Returns the number of definitions, i.e. one past the largest ID.
+  std::size_t size() const;
+
+  /// Returns the location of the definition `id`.
+  Location locationOf(unsigned id) const;
+
+ private:
+  /// Identifies a definition by its file and offset.
+  struct Key {
+    llvm::sys::fs::UniqueID file;
+    unsigned offset;
+
+    bool operator==(const Key& other) const {
+      return file == other.file && offset == other.offset;
+    }
+  };
+
+  /// Hashes a `Key`.
+  struct KeyHash {
+    std::size_t operator()(const Key& key) const;
+  };
+
+  /// Guards all members below.
+  mutable std::mutex _mutex;
+
+  /// The location of each definition, by ID.
+  std::vector<Location> _locations;
+
+  /// The ID of each definition seen in a file.
+  std::unordered_map<Key, unsigned, KeyHash> _ids;
+
+  /// The ID of each definition added without a file identity.
+  std::unordered_map<const Location, unsigned> _addedIds;
+
+  /// Whether each definition was used, by ID.
+  llvm::BitVector _used;
+};
+
+}  // namespace tidy
+
+#endif  // MACRO_EXPAND_DEFINITION_TABLE_HPP
@@ -0,0 +1,85 @@
+#ifndef MACRO_EXPAND_INCLUDE_GRAPH_HPP
+#define MACRO_EXPAND_INCLUDE_GRAPH_HPP
+
+// LLVM includes
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/StringSet.h>
+
+// Standard includes
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace clang {
+class SourceManager;
+}
+
+namespace tidy {
+class Changes;
+}
+
+namespace tidy {
+
+/// The files each translation unit read, as recorded by earlier runs.
+///
+/// After preprocessing a translation unit, every file its `SourceManager`
+/// looked at (the main file, all headers, including system headers) is
+/// recorded under the absolute path of the main file. The graph is saved as
+/// JSON with a table of file names and, per main file, the indices of the
+/// files it read, so shared headers are stored once.
+///
+/// A translation unit is affected by a set of changes if its main file or any
+/// file it read changed, or if it is not in the graph at all.
+class IncludeGraph {
+ public:
+  /// Loads the graph saved to `filename`, if any. A missing or unreadable file
+  /// leaves the graph empty. Without a `filename`, the graph lives in memory.
+  explicit IncludeGraph(std::string filename = std::string());
+
+  /// Returns true if the translation unit of the absolute `mainFile` read a
+  /// file in `changes`, or has not been recorded.
+  bool isAffected(const std::string& mainFile, const Changes& changes) const;
+
+  /// Replaces the files recorded for `mainFile` with those `sourceManager`
+  /// read.
+  void record(const std::string& mainFile,
+              const clang::SourceManager& sourceManager);
+
+  /// Returns every file recorded as read by one of `mainFiles`.
+  llvm::StringSet<> filesReadBy(const std::vector<std::string>& mainFiles) const;
+
+  /// Returns every file recorded as read by some translation unit.
+  std::vector<std::string> files() const;
+
+  /// Forgets `mainFile`, e.g. because it failed to preprocess, so it is
+  /// treated as affected next time.
+  void forget(const std::string& mainFile);
+
+  /// Writes the graph back to the file it was loaded from, if any.
+  void save() const;
+
+ private:
+  /// Returns the index of `file` in `_files`, adding it if necessary.
+  std::size_t _indexOf(llvm::StringRef file);
+
+  /// The file the graph is saved to.
+  std::string _filename;
+
+  /// Guards all members below.
+  mutable std::mutex _mutex;
+
+  /// Every file read by some translation unit.
+  std::vector<std::string> _files;
+
+  /// The index of each file in `_files`.
+  llvm::StringMap<std::size_t> _fileIndices;
+
+  /// The indices of the files each main file read.
+  llvm::StringMap<std::vector<std::size_t>> _translationUnits;
+};
+
+}  // namespace tidy
+
+#endif  // MACRO_EXPAND_INCLUDE_GRAPH_HPP
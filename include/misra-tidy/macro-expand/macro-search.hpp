@@ -2,16 +2,22 @@
 #ifndef MACRO_EXPAND_PPPREPROCESSOR_HOOKS_HPP
 #define MACRO_EXPAND_PPPREPROCESSOR_HOOKS_HPP
 
+// Project includes
+#include "misra-tidy/macro-expand/changes.hpp"
+
 // Clang includes
 #include <clang/Basic/SourceLocation.h>
 #include <clang/Lex/PPCallbacks.h>
 
 // LLVM includes
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
 
 // Standard includes
 #include <iosfwd>
 #include <unordered_map>
+#include <vector>
 
 namespace clang {
     class LangOptions;
@@ -30,8 +36,15 @@ namespace llvm {
     class SmallString;
 }
 
+namespace clang {
+    namespace tooling {
+        class Replacement;
+    }
+}  // namespace clang
+
 namespace tidy {
     struct Query;
+    struct UnitRecords;
 }  // namespace tidy
 
 namespace std {
@@ -48,6 +61,7 @@ namespace std {
 
 namespace tidy {
     namespace MacroExpand {
+        struct MacroSearchAccess;
 
         /// Class responsible for inspecting macros during symbol search.
         ///
@@ -64,9 +78,11 @@ namespace tidy {
         /// this functionality incurs very little performance overhead.
         struct MacroSearch : public clang::PPCallbacks {
         public:
-            /// Constructor.
+            /// Constructor, taking the ongoing `Query` and the `UnitRecords` of the
+            /// translation unit to record into.
             MacroSearch(clang::CompilerInstance& compiler,
-                Query& query);
+                Query& query,
+                UnitRecords& records);
 
             /// Hook for any macro expansion. A macro expansion will either be a
             /// function-macro call like `f(x)`, or simply an object-macro expansion like
@@ -90,6 +106,10 @@ namespace tidy {
             void EndOfMainFile() override;
 
         private:
+            /// Lets the microbenchmarks in `macro-expand-bench` drive the private
+            /// hot paths below in isolation.
+            friend struct MacroSearchAccess;
+
             using ParameterMap = llvm::StringMap<llvm::SmallString<32>>;
 
             /// Rewrites a function-macro contents using the arguments it was invoked
@@ -106,6 +126,26 @@ namespace tidy {
             /// preprocessor.
             std::string _getSpelling(const clang::Token& token) const;  // NOLINT
 
+            /// Returns false if `location` is in a file excluded by the query's
+            /// path filters. The answer is computed once per file.
+            bool _isAccepted(clang::SourceLocation location);
+
+            /// Returns the edit of `range` to `text`, against the file as read.
+            /// With `removesLine`, the rest of the line goes too if only
+            /// whitespace remains, as the rewriter's `RemoveLineIfEmpty` does.
+            clang::tooling::Replacement _replacementOf(clang::CharSourceRange range,
+                llvm::StringRef text,
+                bool removesLine) const;
+
+            /// Records the removal of the directive starting at `location` and
+            /// ending at `end`, and its line if nothing else is left on it.
+            void _recordRemoval(clang::SourceLocation location,
+                clang::SourceLocation end);
+
+            /// Returns true if the lines of `range` overlap the lines changed
+            /// since the query's `-since` revision.
+            bool _isChanged(clang::SourceRange range);
+
             /// The current `clang::SourceManager` from the compiler.
             clang::SourceManager& _sourceManager;
 
@@ -118,12 +158,22 @@ namespace tidy {
             /// The ongoing `Query` object.
             Query& _query;
 
+            /// What this translation unit found.
+            UnitRecords& _records;
+
             struct MacroContext {
                 const clang::MacroInfo &_defMacro;
                 llvm::Optional<const clang::SourceRange> _undefRange;
                 size_t _count = 0;
             };
             std::unordered_map<clang::SourceLocation, MacroContext> _defCountMap;
+
+            /// Whether each file seen so far is accepted by the path filters.
+            llvm::DenseMap<clang::FileID, bool> _acceptedFiles;
+
+            /// The changed lines of each file seen so far, or null if it did not
+            /// change.
+            llvm::DenseMap<clang::FileID, const std::vector<Changes::LineRange>*> _changedLines;
         };
 
     }  // namespace MacroExpand
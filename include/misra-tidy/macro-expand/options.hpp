@@ -1,6 +1,10 @@
 #ifndef MACRO_EXPAND_OPTIONS_HPP
 #define MACRO_EXPAND_OPTIONS_HPP
 
+// Standard includes
+#include <string>
+#include <vector>
+
 namespace tidy {
     /// Options for a query.
     struct Options {
@@ -16,6 +20,76 @@ namespace tidy {
         /// Whether to include the rewritten function body information for the
         /// function.
         bool wantsRewritten;
+
+        /// The directory of the on-disk token cache, or empty to lex every file.
+        std::string tokenCacheDirectory;
+
+        /// The file remembering failed include lookups across runs, or empty.
+        std::string includeCacheFile;
+
+        /// Whether to skip translation units a prescan shows to define no macros.
+        bool wantsPrescan = true;
+
+        /// Globs of the only files to expand macros in and remove them from.
+        std::vector<std::string> includePaths;
+
+        /// Globs of files never to expand macros in or remove them from.
+        std::vector<std::string> excludePaths;
+
+        /// Regular expressions of the only macro names to expand and remove.
+        std::vector<std::string> macros;
+
+        /// Regular expressions of macro names never to expand or remove.
+        std::vector<std::string> skippedMacros;
+
+        /// The git revision to compare the work tree against, or empty to run on
+        /// every translation unit.
+        std::string since;
+
+        /// The file recording which files each translation unit read, or empty
+        /// for the default location inside the git directory.
+        std::string includeGraphFile;
+
+        /// Whether to only expand macros on lines changed since `since`.
+        bool wantsChangedLinesOnly = false;
+
+        /// Whether rewritten files are written to disk. If not, their contents
+        /// are kept in memory and returned with the result.
+        bool wantsFilesWritten = true;
+
+        /// The file to export every edit to as clang-apply-replacements YAML,
+        /// instead of applying them, or empty.
+        std::string exportFixesFile;
+
+        /// The shard of the sources to run on, from 0 to `shardCount - 1`.
+        unsigned shardIndex = 0;
+
+        /// The number of shards the sources are split into. With more than one,
+        /// unused header definitions are left for `macro-expand merge`.
+        unsigned shardCount = 1;
+
+        /// Whether to balance the shards by source size rather than split the
+        /// sources by a hash of their paths.
+        bool wantsShardsBySize = false;
+
+        /// The file whose contents are `stdinContents` rather than what is on
+        /// disk, or empty.
+        std::string stdinFile;
+
+        /// The unsaved contents of `stdinFile`, as read from standard input.
+        std::string stdinContents;
+
+        /// The number of threads preprocessing translation units and applying
+        /// edits, or 0 for one per core.
+        unsigned jobs = 0;
+
+        /// The file remembering how long each translation unit took across runs,
+        /// to start the longest first, or empty.
+        std::string timingHistoryFile;
+
+        /// The directory of the journal of finished translation units and
+        /// written files, to resume an interrupted run, or empty.
+        std::string journalDirectory;
     };
 }  // namespace tidy
 
@@ -0,0 +1,137 @@
+#ifndef MACRO_EXPAND_PRESCAN_HPP
+#define MACRO_EXPAND_PRESCAN_HPP
+
+// Project includes
+#include "misra-tidy/common/bloom-filter.hpp"
+
+// LLVM includes
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/StringSet.h>
+
+// Standard includes
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace clang {
+class CompilerInvocation;
+}
+
+namespace llvm {
+class MemoryBuffer;
+}
+
+namespace tidy {
+class FileCache;
+}
+
+namespace tidy {
+namespace MacroExpand {
+
+/// \ingroup MacroExpand
+///
+/// Decides cheaply whether preprocessing a translation unit can produce
+/// anything at all.
+///
+/// `MacroSearch` only ever expands or removes macros defined in non-system
+/// files. A translation unit whose main file and non-system include closure
+/// contain no `#define` therefore produces no records. The prescan finds the
+/// `#define` and `#include` directives of each file with a `memchr` scan for
+/// `#`, without lexing or evaluating conditionals, and resolves includes
+/// against the invocation's search paths. Whenever it cannot be sure (computed
+/// includes, `#include_next`, frameworks, header maps, forced includes,
+/// headers it cannot find), it answers that the translation unit may define
+/// macros.
+///
+/// When unused definitions are kept, a translation unit only matters if it
+/// uses a project macro. For that, the names defined in the include closures
+/// of all translation units are collected first (`collectDefinitions()`) into
+/// a Bloom filter (`buildNameFilter()`), against which the identifiers outside
+/// non-expanding directives of every file are then checked (`mayUseMacros()`).
+class Prescan {
+ public:
+  /// Creates a prescan reading files through `fileCache`.
+  explicit Prescan(std::shared_ptr<FileCache> fileCache);
+
+  /// Returns false if the translation unit of the absolute `mainFile`,
+  /// preprocessed with `invocation`, certainly defines no macro in a non-system
+  /// file.
+  bool mayDefineMacros(const clang::CompilerInvocation& invocation,
+                       const std::string& mainFile);
+
+  /// Collects the names of the macros defined in the include closure of the
+  /// translation unit of `mainFile`.
+  void collectDefinitions(const clang::CompilerInvocation& invocation,
+                          const std::string& mainFile);
+
+  /// Builds the filter of all names collected so far. Without it (or if some
+  /// include closure could not be determined), `mayUseMacros()` always
+  /// answers true.
+  void buildNameFilter();
+
+  /// Returns false if the translation unit of `mainFile` certainly uses no
+  /// macro collected by `collectDefinitions()` in a non-system file.
+  bool mayUseMacros(const clang::CompilerInvocation& invocation,
+                    const std::string& mainFile);
+
+ private:
+  /// The directives found in a file.
+  struct Scan {
+    /// The contents scanned, to notice when the file cache re-read the file.
+    std::shared_ptr<const llvm::MemoryBuffer> contents;
+
+    /// Whether the file has a `#define`.
+    bool definesMacros = false;
+
+    /// The names of the macros the file defines.
+    std::vector<std::string> definedNames;
+
+    /// Whether the file mentions a name in the name filter, once checked.
+    llvm::Optional<bool> usesMacros;
+
+    /// Whether the file has an include directive we cannot follow.
+    bool isOpaque = false;
+
+    /// The included names, and whether each was written in angle brackets.
+    std::vector<std::pair<std::string, bool>> includes;
+  };
+
+  /// Returns the scan of the file at `path`, or null if it cannot be read.
+  Scan* _scan(const std::string& path);
+
+  /// Calls `visit` with the scans of `mainFile` and its non-system include
+  /// closure until it returns true. Returns false if the closure could not be
+  /// determined.
+  bool _forEachInClosure(const clang::CompilerInvocation& invocation,
+                         const std::string& mainFile,
+                         llvm::function_ref<bool(Scan&)> visit);
+
+  /// Returns true if the identifiers of `scan` outside `#define`, `#undef`,
+  /// `#ifdef` and the like hit the name filter.
+  bool _usesMacros(const Scan& scan) const;
+
+  /// The file cache files are read through.
+  std::shared_ptr<FileCache> _fileCache;
+
+  /// The scans of every file read so far.
+  llvm::StringMap<Scan> _scans;
+
+  /// The macro names collected by `collectDefinitions()`.
+  llvm::StringSet<> _definedNames;
+
+  /// Whether every include closure passed to `collectDefinitions()` was
+  /// determined, so `_definedNames` has all names.
+  bool _hasAllDefinitions = true;
+
+  /// The filter of `_definedNames`, once built.
+  llvm::Optional<BloomFilter> _nameFilter;
+};
+
+}  // namespace MacroExpand
+}  // namespace tidy
+
+#endif  // MACRO_EXPAND_PRESCAN_HPP
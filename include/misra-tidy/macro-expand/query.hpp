@@ -3,18 +3,35 @@
 #define TIDY_UTILS_COMMON_QUERY_HPP
 
 // Project includes
+#include "misra-tidy/common/caching-file-system.hpp"
 #include "misra-tidy/common/call-data.hpp"
 #include "misra-tidy/common/definition-data.hpp"
+#include "misra-tidy/common/location.hpp"
+#include "misra-tidy/common/name-filter.hpp"
+#include "misra-tidy/common/path-filter.hpp"
+#include "misra-tidy/macro-expand/changes.hpp"
+#include "misra-tidy/macro-expand/definition-table.hpp"
+#include "misra-tidy/macro-expand/include-graph.hpp"
 #include "misra-tidy/macro-expand/options.hpp"
+#include "misra-tidy/macro-expand/statistics.hpp"
+#include "misra-tidy/macro-expand/token-cache.hpp"
 
 // Clang includes
-#include <clang/Rewrite/Core/Rewriter.h>
+#include <clang/Tooling/Core/Replacement.h>
 
 // LLVM includes
 #include <llvm/ADT/Optional.h>
 
 // Standard includes
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace tidy {
 
@@ -33,25 +50,119 @@ struct Query {
 
       /// Possibly collected `DefinitionData`.
       llvm::Optional<DefinitionData> definition;
+
+      /// The configuration (`-D`/`-U` arguments) the macro was expanded in, if
+      /// its translation unit's main file is preprocessed in several.
+      std::string configuration;
   };
   /// A list of every single macro invocation in the source file under consideration
   std::vector<IndividualMacroInfo> _macroInvocations;
 
-  /// A count of how often every macro definition encountered in a non-system, writable 
-  /// header was used
-  using MacroDefCountMap = std::unordered_map<const Location, std::pair</*count*/size_t, /*undefLocation*/llvm::Optional<Location>>>;
-  MacroDefCountMap _macroDefinitionsInHeaders;
+  /// Every macro definition encountered in a non-system, writable header, and
+  /// whether any translation unit used it.
+  DefinitionTable _headerDefinitions;
+
+  /// For main files preprocessed in several configurations, the number of
+  /// configurations still to come. Unused definitions in such a file are only
+  /// removed by the last one.
+  std::unordered_map<std::string, size_t> _pendingConfigurations;
+
+  /// The uses of definitions in main files with pending configurations, as
+  /// the highest count seen in any configuration so far.
+  std::unordered_map<const Location, size_t> _mainFileDefinitionUses;
 
   /// The `Options` of the query (i.e. what information the user wants).
   const Options options;
-  
-  /// A `clang::Rewriter` to rewrite source code. 
-  llvm::Optional<clang::Rewriter> _rewriter;
+
+  /// The file system cache shared by all translation units of the run.
+  std::shared_ptr<FileCache> _fileCache;
+
+  /// The files the query may touch, if restricted by `-include-path` or
+  /// `-exclude-path`.
+  llvm::Optional<PathFilter> _pathFilter;
+
+  /// The macros the query may touch, if restricted by `-macros` or
+  /// `-skip-macros`.
+  llvm::Optional<NameFilter> _nameFilter;
+
+  /// The new contents of every file rewritten so far, by absolute path, unless
+  /// `options.wantsFilesWritten`.
+  std::map<std::string, std::string> _writtenFiles;
+
+  /// Every edit of the run, against the original contents of the files.
+  /// Nothing is written while translation units are preprocessed; the edits
+  /// are applied file by file at the end of the run, or exported if
+  /// `options.exportFixesFile` is set.
+  std::vector<clang::tooling::Replacement> _replacements;
+
+  /// The files changed since the `-since` revision, if given.
+  llvm::Optional<Changes> _changes;
+
+  /// The files read by each translation unit, in this and earlier runs. Set
+  /// whenever `_changes` is. Shared by the runs of `-watch`.
+  std::shared_ptr<IncludeGraph> _includeGraph;
+
+  /// The cache of pretokenized translation units, if enabled.
+  llvm::Optional<TokenCache> _tokenCache;
+
+  /// Counters and phase timings of the run.
+  Statistics statistics;
+
+  /// Called with the current `statistics` after every translation unit, e.g.
+  /// to report the progress of long runs. May be empty. Called with `_mutex`
+  /// held.
+  std::function<void(const Statistics&)> progress;
+
+  /// Guards `_pendingConfigurations`, `_mainFileDefinitionUses`, `statistics`
+  /// and `_writtenFiles`, which translation units and files processed in
+  /// parallel update.
+  std::mutex _mutex;
 private:
     Query(const Query&);          ///not copy constructible
     void operator=(const Query&); ///not copy assignable
 };
 
+/// What a single translation unit found.
+///
+/// Every translation unit records into its own `UnitRecords`, so translation
+/// units preprocessed in parallel share nothing but the few members guarded
+/// by `Query::_mutex`. The records are merged into the `Query` afterwards, in
+/// the order the translation units were given, which keeps the result the same
+/// however the work was spread over threads.
+struct UnitRecords {
+  /// An expansion and the edit making it.
+  struct Expansion {
+    /// The record of the expansion.
+    Query::IndividualMacroInfo macro;
+
+    /// The edit replacing the call with the expansion.
+    clang::tooling::Replacement replacement;
+  };
+
+  /// The configuration (`-D`/`-U` arguments) of the translation unit, if its
+  /// main file is preprocessed in several; empty otherwise.
+  std::string configuration;
+
+  /// Every expansion this translation unit made.
+  std::vector<Expansion> expansions;
+
+  /// The edits removing unused definitions (and their `#undef`s) from the
+  /// main file.
+  std::vector<clang::tooling::Replacement> removals;
+
+  /// The counters of the translation unit, added to the query's once it ends.
+  Statistics statistics;
+
+  /// The header definitions the translation unit saw, by ID in the query's
+  /// table, and whether it used each. Only recorded for the journal
+  /// (`options.journalDirectory`); otherwise they go straight to the table.
+  std::vector<std::pair<unsigned, bool>> headerDefinitions;
+
+  /// The uses of the main file's definitions, if it has configurations still
+  /// to come. Only recorded for the journal.
+  std::vector<std::pair<Location, size_t>> mainFileDefinitionUses;
+};
+
 }  // namespace tidy
 
 #endif  // TIDY_UTILS_COMMON_QUERY_HPP
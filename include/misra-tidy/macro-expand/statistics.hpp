@@ -0,0 +1,120 @@
+#ifndef MACRO_EXPAND_STATISTICS_HPP
+#define MACRO_EXPAND_STATISTICS_HPP
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// Standard includes
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <string>
+
+namespace tidy {
+
+/// Counters and phase timings of a single macro-expand run.
+///
+/// The statistics are collected on the `Query` while the search runs and can be
+/// printed with `-stats` as one line of JSON, which `macro-expand-bench compare`
+/// understands.
+struct Statistics {
+  /// Measures the wall-clock time of a phase from construction to destruction
+  /// and adds it to the phase's total.
+  class Timer {
+   public:
+    /// Starts timing `phase`.
+    Timer(Statistics& statistics, const char* phase);
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+    /// Stops timing and records the elapsed time.
+    ~Timer();
+
+   private:
+    Statistics& _statistics;
+    const char* _phase;
+    std::chrono::steady_clock::time_point _start;
+  };
+
+  /// Converts the `Statistics` to JSON.
+  nlohmann::json toJson() const;
+
+  /// Reads `Statistics` back from the JSON `toJson()` made. Missing counters
+  /// are zero.
+  static Statistics fromJson(const nlohmann::json& json);
+
+  /// Adds the counters and completed phase timings of `other`, e.g. those of
+  /// a single translation unit, to these.
+  Statistics& operator+=(const Statistics& other);
+
+  /// The number of translation units the search ran on.
+  std::size_t translationUnits = 0;
+
+  /// The number of translation units that had compile errors.
+  std::size_t failedTranslationUnits = 0;
+
+  /// The number of translation units skipped because the prescan found no
+  /// macro definition they could reach.
+  std::size_t translationUnitsSkipped = 0;
+
+  /// The number of translation units skipped because no file they read changed
+  /// since the `-since` revision.
+  std::size_t translationUnitsUnchanged = 0;
+
+  /// The number of translation units not preprocessed again because the
+  /// journal of an interrupted run had their records.
+  std::size_t translationUnitsReplayed = 0;
+
+  /// The number of macro expansions recorded.
+  std::size_t expansions = 0;
+
+  /// The number of unused macro definitions removed.
+  std::size_t definitionsRemoved = 0;
+
+  /// The number of translation units preprocessed from the token cache.
+  std::size_t tokenCacheHits = 0;
+
+  /// The number of translation units whose token cache entry was (re)built.
+  std::size_t tokenCacheMisses = 0;
+
+  /// The number of distinct normalized compile commands, each of which was
+  /// turned into a compiler invocation once.
+  std::size_t compileCommandGroups = 0;
+
+  /// The number of compile commands skipped because they repeat the command
+  /// of the same file.
+  std::size_t duplicateCommandsSkipped = 0;
+
+  /// The number of translation units whose main file is preprocessed in more
+  /// than one configuration.
+  std::size_t multiConfigurationUnits = 0;
+
+  /// The number of missing paths preloaded from the include cache.
+  std::size_t missingFilesPreloaded = 0;
+
+  /// The number of edits dropped because they overlapped another edit of the
+  /// same file, e.g. from two configurations seeing a header differently.
+  std::size_t editsDropped = 0;
+
+  /// The number of bytes written to rewritten files.
+  std::size_t bytesWritten = 0;
+
+  /// The peak resident set size of the process in bytes, or zero if the
+  /// platform does not report it.
+  std::size_t peakResidentBytes = 0;
+
+  /// Wall-clock seconds spent in each phase of the run, by phase name.
+  std::map<std::string, double> phaseSeconds;
+
+  /// When each phase still in progress started, by phase name. Its time is
+  /// only added to `phaseSeconds` once its `Timer` stops.
+  std::map<std::string, std::chrono::steady_clock::time_point> openPhases;
+
+  /// Returns `phaseSeconds` plus the time phases still in progress have taken
+  /// so far, e.g. to report on long runs while they run.
+  std::map<std::string, double> phaseSecondsSoFar() const;
+};
+
+}  // namespace tidy
+
+#endif  // MACRO_EXPAND_STATISTICS_HPP
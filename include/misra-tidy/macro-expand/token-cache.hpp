@@ -0,0 +1,88 @@
+#ifndef MACRO_EXPAND_TOKEN_CACHE_HPP
+#define MACRO_EXPAND_TOKEN_CACHE_HPP
+
+// LLVM includes
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+
+// Standard includes
+#include <mutex>
+#include <string>
+
+namespace clang {
+class SourceManager;
+}
+
+namespace tidy {
+
+/// An on-disk cache of pretokenized translation units.
+///
+/// Each entry is a clang PTH file holding the raw token streams of a
+/// translation unit's main file and every header it included, next to a
+/// manifest with the size, modification time and MD5 of each of those files.
+/// Entries are keyed by the main file and a hash of the language options. A
+/// valid entry is memory-mapped by the preprocessor (as its `-token-cache`),
+/// which then reads tokens from it instead of lexing the cached files again.
+///
+/// An entry is only valid if every file it covers is unchanged. Files whose
+/// size or modification time differ from the manifest are compared by content
+/// hash. The validity of each file is checked at most once per run.
+///
+/// Clang can only read one PTH file per translation unit, so the cache cannot
+/// share header token streams between translation units. Each entry holds its
+/// own copy of the tokens of all its headers, so disk use grows with
+/// translation units times headers. Changing a shared header invalidates the
+/// entry of every translation unit that includes it, and changing a main file
+/// always misses.
+class TokenCache {
+ public:
+  /// The files of a cache entry.
+  struct Entry {
+    /// The PTH file.
+    std::string tokens;
+
+    /// The manifest of the files covered by `tokens`.
+    std::string manifest;
+  };
+
+  /// Creates a cache in `directory`, which is created if necessary.
+  explicit TokenCache(std::string directory);
+
+  /// Returns the entry for the translation unit of `mainFile` preprocessed with
+  /// the language options hashed to `languageHash`.
+  Entry entryFor(llvm::StringRef mainFile, llvm::StringRef languageHash) const;
+
+  /// Returns true if the tokens of `entry` exist and all files they cover are
+  /// unchanged since they were written. A missing, truncated or malformed
+  /// manifest makes the entry invalid.
+  bool isValid(const Entry& entry);
+
+  /// Moves the freshly written `temporaryTokens` into place for `entry` and
+  /// writes its manifest, listing every file in `sourceManager`.
+  void commit(const Entry& entry,
+              const std::string& temporaryTokens,
+              const clang::SourceManager& sourceManager);
+
+ private:
+  /// Returns true if `filename` still has the content described by the
+  /// manifest fields.
+  bool _isUnchanged(const std::string& filename,
+                    unsigned long long size,
+                    long long modificationTime,
+                    const std::string& md5);
+
+  /// The directory the cache lives in.
+  std::string _directory;
+
+  /// Guards `_checkedFiles`, since translation units are preprocessed in
+  /// parallel.
+  std::mutex _mutex;
+
+  /// Files whose validity was already checked during this run, with the
+  /// result of the check.
+  llvm::StringMap<bool> _checkedFiles;
+};
+
+}  // namespace tidy
+
+#endif  // MACRO_EXPAND_TOKEN_CACHE_HPP
@@ -0,0 +1,52 @@
+// Project includes
+#include "misra-tidy/common/bloom-filter.hpp"
+
+// LLVM includes
+#include <llvm/ADT/Hashing.h>
+
+// Standard includes
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace tidy {
+    namespace {
+        /// Returns the two independent hashes of `string` that all bit positions
+        /// are derived from (Kirsch and Mitzenmacher's double hashing).
+        std::pair<std::uint64_t, std::uint64_t> hashesOf(llvm::StringRef string) {
+            const std::uint64_t first = llvm::hash_value(string);
+            // An odd second hash visits every bit of a power-of-two table.
+            const std::uint64_t second = (first >> 32 | first << 32) * 0x9E3779B97F4A7C15ull | 1;
+            return { first, second };
+        }
+    }  // namespace
+
+    constexpr unsigned BloomFilter::kHashes;
+
+    BloomFilter::BloomFilter(std::size_t expectedSize) {
+        std::uint64_t bits = 64;
+        while (bits < expectedSize * 10)
+            bits <<= 1;
+        _bits.assign(bits / 64, 0);
+        _mask = bits - 1;
+    }
+
+    void BloomFilter::insert(llvm::StringRef string) {
+        const auto hashes = hashesOf(string);
+        for (unsigned i = 0; i < kHashes; ++i) {
+            const auto bit = (hashes.first + i * hashes.second) & _mask;
+            _bits[bit / 64] |= std::uint64_t(1) << (bit % 64);
+        }
+    }
+
+    bool BloomFilter::mayContain(llvm::StringRef string) const {
+        const auto hashes = hashesOf(string);
+        for (unsigned i = 0; i < kHashes; ++i) {
+            const auto bit = (hashes.first + i * hashes.second) & _mask;
+            if (!(_bits[bit / 64] & std::uint64_t(1) << (bit % 64)))
+                return false;
+        }
+        return true;
+    }
+
+}  // namespace tidy
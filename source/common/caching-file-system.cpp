@@ -0,0 +1,406 @@
+// Project includes
+#include "misra-tidy/common/caching-file-system.hpp"
+#include "misra-tidy/common/routines.hpp"
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// LLVM includes
+#include <llvm/ADT/Hashing.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/Twine.h>
+#include <llvm/Support/Chrono.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Standard includes
+#include <cstddef>
+#include <ctime>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace tidy {
+    namespace {
+        /// A view of cached contents that keeps them alive, so a translation unit
+        /// may go on reading a file invalidated or replaced meanwhile.
+        class SharedBuffer : public llvm::MemoryBuffer {
+        public:
+            SharedBuffer(std::shared_ptr<const llvm::MemoryBuffer> contents,
+                std::string name,
+                bool requiresNullTerminator)
+                : _contents(std::move(contents))
+                , _name(std::move(name)) {
+                // Cached contents are always null-terminated.
+                init(_contents->getBufferStart(), _contents->getBufferEnd(), requiresNullTerminator);
+            }
+
+            llvm::StringRef getBufferIdentifier() const override {
+                return _name;
+            }
+
+            BufferKind getBufferKind() const override {
+                return _contents->getBufferKind();
+            }
+
+        private:
+            std::shared_ptr<const llvm::MemoryBuffer> _contents;
+            std::string _name;
+        };
+
+        /// A file opened through a `CachingFileSystem`, backed by cached contents.
+        class CachedFile : public clang::vfs::File {
+        public:
+            CachedFile(clang::vfs::Status status,
+                std::shared_ptr<const llvm::MemoryBuffer> contents)
+                : _status(std::move(status))
+                , _contents(std::move(contents)) {
+            }
+
+            llvm::ErrorOr<clang::vfs::Status> status() override {
+                return _status;
+            }
+
+            llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> getBuffer(const llvm::Twine& name,
+                int64_t /*fileSize*/,
+                bool requiresNullTerminator,
+                bool /*isVolatile*/) override {
+                return std::unique_ptr<llvm::MemoryBuffer>(
+                    new SharedBuffer(_contents, name.str(), requiresNullTerminator));
+            }
+
+            std::error_code close() override {
+                return {};
+            }
+
+        private:
+            clang::vfs::Status _status;
+            std::shared_ptr<const llvm::MemoryBuffer> _contents;
+        };
+
+        /// Iterates over a cached directory listing, naming entries relative to
+        /// the directory as it was requested.
+        class CachedDirectoryIterator : public clang::vfs::detail::DirIterImpl {
+        public:
+            CachedDirectoryIterator(std::string directory,
+                std::shared_ptr<const FileCache::DirectoryListing> listing)
+                : _directory(std::move(directory))
+                , _listing(std::move(listing)) {
+                _update();
+            }
+
+            std::error_code increment() override {
+                ++_index;
+                _update();
+                return {};
+            }
+
+        private:
+            void _update() {
+                if (_index >= _listing->size()) {
+                    CurrentEntry = clang::vfs::Status();
+                    return;
+                }
+                const auto& entry = (*_listing)[_index];
+                llvm::SmallString<256> path(_directory);
+                llvm::sys::path::append(path, entry.first);
+                CurrentEntry = clang::vfs::Status::copyWithNewName(entry.second, path);
+            }
+
+            std::string _directory;
+            std::shared_ptr<const FileCache::DirectoryListing> _listing;
+            std::size_t _index = 0;
+        };
+    }  // namespace
+
+    FileCache::FileCache(llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem> underlying)
+        : _underlying(std::move(underlying)) {
+    }
+
+    llvm::ErrorOr<clang::vfs::Status> FileCache::status(const std::string& path) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            const auto cached = _statuses.find(path);
+            if (cached != _statuses.end()) {
+                if (cached->second.error)
+                    return cached->second.error;
+                return cached->second.value;
+            }
+        }
+
+        Cached<clang::vfs::Status> result;
+        auto status = _underlying->status(path);
+        if (status)
+            result.value = std::move(*status);
+        else
+            result.error = status.getError();
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _statuses.insert(std::make_pair(path, result));
+        if (result.error)
+            return result.error;
+        return result.value;
+    }
+
+    llvm::ErrorOr<std::shared_ptr<const llvm::MemoryBuffer>> FileCache::contents(
+        const std::string& path) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            const auto cached = _contents.find(path);
+            if (cached != _contents.end()) {
+                if (cached->second.error)
+                    return cached->second.error;
+                return cached->second.value;
+            }
+        }
+
+        Cached<std::shared_ptr<const llvm::MemoryBuffer>> result;
+        auto file = _underlying->openFileForRead(path);
+        if (file) {
+            // Volatile, so the contents are copied rather than mapped: a mapping
+            // would change under us if the file is rewritten in place.
+            auto buffer = (*file)->getBuffer(path, -1,
+                /*RequiresNullTerminator=*/true, /*IsVolatile=*/true);
+            if (buffer)
+                result.value = std::move(*buffer);
+            else
+                result.error = buffer.getError();
+        }
+        else {
+            result.error = file.getError();
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        // Another thread may have read the file meanwhile; keep its buffer so
+        // everyone shares the same one.
+        const auto inserted = _contents.insert(std::make_pair(path, std::move(result)));
+        const auto& cached = inserted.first->second;
+        if (cached.error)
+            return cached.error;
+        return cached.value;
+    }
+
+    llvm::ErrorOr<std::shared_ptr<const FileCache::DirectoryListing>> FileCache::listing(
+        const std::string& path) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            const auto cached = _listings.find(path);
+            if (cached != _listings.end()) {
+                if (cached->second.error)
+                    return cached->second.error;
+                return cached->second.value;
+            }
+        }
+
+        Cached<std::shared_ptr<const DirectoryListing>> result;
+        auto entries = std::make_shared<DirectoryListing>();
+        std::error_code error;
+        for (auto it = _underlying->dir_begin(path, error);
+             !error && it != clang::vfs::directory_iterator();
+             it.increment(error)) {
+            entries->emplace_back(llvm::sys::path::filename(it->getName()), *it);
+        }
+        if (error)
+            result.error = error;
+        else
+            result.value = std::move(entries);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        const auto inserted = _listings.insert(std::make_pair(path, std::move(result)));
+        const auto& cached = inserted.first->second;
+        if (cached.error)
+            return cached.error;
+        return cached.value;
+    }
+
+    void FileCache::invalidate(llvm::StringRef path) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _statuses.erase(path);
+        _contents.erase(path);
+        _listings.erase(llvm::sys::path::parent_path(path));
+    }
+
+    void FileCache::replace(const std::string& path, llvm::StringRef contents) {
+        const auto original = _underlying->status(path);
+        Cached<clang::vfs::Status> status;
+        if (original && !original->isDirectory()) {
+            status.value = clang::vfs::Status(path, original->getUniqueID(),
+                original->getLastModificationTime(), original->getUser(), original->getGroup(),
+                contents.size(), original->getType(), original->getPermissions());
+        }
+        else {
+            // A file only the editor knows about yet: make up an identity.
+            status.value = clang::vfs::Status(path,
+                llvm::sys::fs::UniqueID(0, llvm::hash_value(path)),
+                llvm::sys::toTimePoint(std::time(nullptr)), 0, 0, contents.size(),
+                llvm::sys::fs::file_type::regular_file,
+                static_cast<llvm::sys::fs::perms>(llvm::sys::fs::all_read | llvm::sys::fs::owner_write));
+        }
+        Cached<std::shared_ptr<const llvm::MemoryBuffer>> buffer;
+        buffer.value = llvm::MemoryBuffer::getMemBufferCopy(contents, path);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _statuses[path] = std::move(status);
+        _contents[path] = std::move(buffer);
+    }
+
+    std::size_t FileCache::loadMissingFiles(const std::string& filename) {
+        auto buffer = llvm::MemoryBuffer::getFile(filename);
+        if (!buffer)
+            return 0;
+        nlohmann::json cache;
+        try {
+            cache = nlohmann::json::parse((*buffer)->getBuffer().str());
+        }
+        catch (const std::exception&) {
+            return 0;
+        }
+        if (!cache.is_object() || !cache.count("directories"))
+            return 0;
+
+        const auto missing = std::make_error_code(std::errc::no_such_file_or_directory);
+        std::size_t loaded = 0;
+        for (const auto& directory : cache["directories"]) {
+            const auto path = directory["path"].get<std::string>();
+            const auto status = this->status(path);
+            if (!status || !status->isDirectory() ||
+                llvm::sys::toTimeT(status->getLastModificationTime()) != directory["mtime"].get<long long>())
+                continue;
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (const auto& name : directory["missing"]) {
+                llvm::SmallString<256> child(path);
+                llvm::sys::path::append(child, name.get<std::string>());
+                Cached<clang::vfs::Status> result;
+                result.error = missing;
+                if (_statuses.insert(std::make_pair(child.str(), result)).second)
+                    ++loaded;
+            }
+        }
+        return loaded;
+    }
+
+    void FileCache::saveMissingFiles(const std::string& filename) {
+        std::vector<std::string> paths;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (const auto& entry : _statuses) {
+                if (entry.second.error == std::errc::no_such_file_or_directory)
+                    paths.push_back(entry.first());
+            }
+        }
+
+        // Group the missing paths by their closest existing directory.
+        std::map<std::string, std::vector<std::string>> groups;
+        for (const auto& path : paths) {
+            llvm::StringRef directory = llvm::sys::path::parent_path(path);
+            while (!directory.empty()) {
+                const auto status = this->status(directory);
+                if (status && status->isDirectory())
+                    break;
+                directory = llvm::sys::path::parent_path(directory);
+            }
+            if (!directory.empty())
+                groups[directory.str()].push_back(path.substr(directory.size() + 1));
+        }
+
+        const auto written = static_cast<long long>(std::time(nullptr));
+        nlohmann::json cache;
+        cache["written"] = written;
+        cache["directories"] = nlohmann::json::array();
+        for (auto& group : groups) {
+            // Compare against the directory as we saw it, not as it is now, so
+            // files created during the run are not recorded as missing.
+            const auto seen = this->status(group.first);
+            const auto current = _underlying->status(group.first);
+            if (!seen || !current)
+                continue;
+            const auto modificationTime = llvm::sys::toTimeT(current->getLastModificationTime());
+            if (llvm::sys::toTimeT(seen->getLastModificationTime()) != modificationTime ||
+                modificationTime >= written)
+                continue;
+            // clang-format off
+            cache["directories"].push_back({
+                {"path", group.first},
+                {"mtime", static_cast<long long>(modificationTime)},
+                {"missing", group.second}
+            });
+            // clang-format on
+        }
+
+        const auto temporary = filename + ".tmp";
+        {
+            std::error_code error;
+            llvm::raw_fd_ostream stream(temporary, error, llvm::sys::fs::F_Text);
+            if (error) {
+                llvm::errs() << "Could not write " << temporary << ": " << error.message() << '\n';
+                return;
+            }
+            stream << cache.dump();
+        }
+        if (const auto error = llvm::sys::fs::rename(temporary, filename))
+            llvm::errs() << "Could not write " << filename << ": " << error.message() << '\n';
+    }
+
+    CachingFileSystem::CachingFileSystem(std::shared_ptr<FileCache> cache,
+        std::string workingDirectory)
+        : _cache(std::move(cache))
+        , _workingDirectory(std::move(workingDirectory)) {
+    }
+
+    llvm::ErrorOr<clang::vfs::Status> CachingFileSystem::status(const llvm::Twine& path) {
+        auto status = _cache->status(_absolute(path));
+        if (!status)
+            return status;
+        return clang::vfs::Status::copyWithNewName(*status, path.str());
+    }
+
+    llvm::ErrorOr<std::unique_ptr<clang::vfs::File>> CachingFileSystem::openFileForRead(
+        const llvm::Twine& path) {
+        const auto absolute = _absolute(path);
+        auto status = _cache->status(absolute);
+        if (!status)
+            return status.getError();
+        if (status->isDirectory())
+            return std::make_error_code(std::errc::is_a_directory);
+        auto contents = _cache->contents(absolute);
+        if (!contents)
+            return contents.getError();
+        return std::unique_ptr<clang::vfs::File>(new CachedFile(
+            clang::vfs::Status::copyWithNewName(*status, path.str()), std::move(*contents)));
+    }
+
+    clang::vfs::directory_iterator CachingFileSystem::dir_begin(const llvm::Twine& directory,
+        std::error_code& error) {
+        auto listing = _cache->listing(_absolute(directory));
+        if (!listing) {
+            error = listing.getError();
+            return {};
+        }
+        error = std::error_code();
+        return clang::vfs::directory_iterator(
+            std::make_shared<CachedDirectoryIterator>(directory.str(), std::move(*listing)));
+    }
+
+    llvm::ErrorOr<std::string> CachingFileSystem::getCurrentWorkingDirectory() const {
+        return _workingDirectory;
+    }
+
+    std::error_code CachingFileSystem::setCurrentWorkingDirectory(const llvm::Twine& path) {
+        _workingDirectory = _absolute(path);
+        return {};
+    }
+
+    std::string CachingFileSystem::_absolute(const llvm::Twine& path) const {
+        // The same way the rest of the run spells paths, so invalidating or
+        // replacing a file reaches every spelling a translation unit used.
+        return Routines::absoluteIn(_workingDirectory, path.str());
+    }
+
+}  // namespace tidy
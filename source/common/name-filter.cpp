@@ -0,0 +1,56 @@
+// Project includes
+#include "misra-tidy/common/name-filter.hpp"
+#include "misra-tidy/common/routines.hpp"
+
+// Standard includes
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace tidy {
+    namespace {
+        /// Compiles `expressions` into one expression matching any of them
+        /// entirely, or none if there are no expressions.
+        llvm::Optional<llvm::Regex> compile(const std::vector<std::string>& expressions) {
+            if (expressions.empty())
+                return llvm::None;
+
+            std::string alternation = "^(";
+            for (const auto& expression : expressions) {
+                std::string error;
+                if (!llvm::Regex(expression).isValid(error))
+                    throw Routines::ErrorCode{ "invalid macro pattern '" + expression + "': " + error };
+                if (alternation.size() > 2)
+                    alternation += '|';
+                alternation += '(' + expression + ')';
+            }
+            alternation += ")$";
+            return llvm::Regex(alternation);
+        }
+    }  // namespace
+
+    NameFilter::NameFilter(const std::vector<std::string>& allowed,
+        const std::vector<std::string>& skipped)
+        : _allowed(compile(allowed))
+        , _skipped(compile(skipped)) {
+    }
+
+    bool NameFilter::accepts(llvm::StringRef name) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            const auto cached = _answers.find(name);
+            if (cached != _answers.end())
+                return cached->second;
+        }
+
+        // Matching only reads the compiled expressions, so threads asking about
+        // new names match at the same time; two asking about the same one both
+        // get the same answer.
+        const bool accepted = (!_allowed || _allowed->match(name)) &&
+            (!_skipped || !_skipped->match(name));
+        std::lock_guard<std::mutex> lock(_mutex);
+        _answers[name] = accepted;
+        return accepted;
+    }
+
+}  // namespace tidy
@@ -0,0 +1,58 @@
+// Project includes
+#include "misra-tidy/common/path-filter.hpp"
+#include "misra-tidy/common/routines.hpp"
+
+// LLVM includes
+#include <llvm/Support/Error.h>
+
+// Standard includes
+#include <string>
+#include <vector>
+
+namespace tidy {
+    namespace {
+        /// Compiles `patterns`, throwing on the first invalid one.
+        std::vector<llvm::GlobPattern> compile(const std::vector<std::string>& patterns) {
+            std::vector<llvm::GlobPattern> compiled;
+            for (const auto& pattern : patterns) {
+                auto glob = llvm::GlobPattern::create(pattern);
+                if (!glob) {
+                    throw Routines::ErrorCode{ "invalid path pattern '" + pattern +
+                        "': " + llvm::toString(glob.takeError()) };
+                }
+                compiled.push_back(std::move(*glob));
+            }
+            return compiled;
+        }
+    }  // namespace
+
+    PathFilter::PathFilter(const std::vector<std::string>& includePatterns,
+        const std::vector<std::string>& excludePatterns)
+        : _includes(compile(includePatterns))
+        , _excludes(compile(excludePatterns)) {
+    }
+
+    bool PathFilter::isEmpty() const noexcept {
+        return _includes.empty() && _excludes.empty();
+    }
+
+    bool PathFilter::accepts(llvm::StringRef path) const {
+        if (!_includes.empty()) {
+            bool included = false;
+            for (const auto& pattern : _includes) {
+                if (pattern.match(path)) {
+                    included = true;
+                    break;
+                }
+            }
+            if (!included)
+                return false;
+        }
+        for (const auto& pattern : _excludes) {
+            if (pattern.match(path))
+                return false;
+        }
+        return true;
+    }
+
+}  // namespace tidy
@@ -0,0 +1,17 @@
+// Project includes
+#include "misra-tidy/common/probes.hpp"
+
+#if defined(MACRO_EXPAND_USDT)
+/// Defines the semaphore of the probe `name`, which tracers increment while
+/// attached.
+#define TIDY_DEFINE_PROBE(name) \
+    __extension__ unsigned short TIDY_PROBE_SEMAPHORE(name) \
+        __attribute__((unused)) __attribute__((section(".probes"))) = 0
+
+TIDY_DEFINE_PROBE(tu__begin);
+TIDY_DEFINE_PROBE(tu__end);
+TIDY_DEFINE_PROBE(macro__accept);
+TIDY_DEFINE_PROBE(macro__reject);
+TIDY_DEFINE_PROBE(macro__defined);
+TIDY_DEFINE_PROBE(file__write);
+#endif
@@ -10,6 +10,9 @@
 #include <clang/Basic/SourceLocation.h>
 #include <clang/Basic/SourceManager.h>
 
+// Standard includes
+#include <utility>
+
 namespace tidy {
     Range::Range(const clang::SourceRange& range,
         const clang::SourceManager& sourceManager)
@@ -18,6 +21,12 @@ namespace tidy {
         , filename(sourceManager.getFilename(range.getBegin())) {
     }
 
+    Range::Range(std::string filename_, Offset begin_, Offset end_)
+        : begin(begin_)
+        , end(end_)
+        , filename(std::move(filename_)) {
+    }
+
     nlohmann::json Range::toJson() const {
         // clang-format off
         return {
@@ -5,6 +5,7 @@
 // Clang includes
 #include <clang/AST/ASTContext.h>
 #include <clang/Basic/SourceLocation.h>
+#include <clang/Lex/MacroInfo.h>
 #include <clang/Rewrite/Core/Rewriter.h>
 
 // LLVM includes
@@ -18,9 +19,15 @@
 // Standard includes
 #include <cassert>
 #include <cstdlib>
+#include <iterator>
 #include <string>
 #include <system_error>
 
+// System includes
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
 namespace tidy {
     namespace Routines {
         bool locationsAreEqual(const clang::SourceLocation& first,
@@ -44,13 +51,57 @@ namespace tidy {
                 context.getLangOpts());
         }
 
+        std::string getDefinitionText(const clang::MacroInfo& info,
+            clang::SourceManager& sourceManager,
+            const clang::LangOptions& languageOptions) {
+            // Using the rewriter (without actually rewriting) is honestly the only way I
+            // found to get at the raw source text in a macro-safe way.
+            const auto start = info.tokens_begin()->getLocation();
+            const auto end = std::prev(info.tokens_end())->getEndLoc();
+            return getSourceText({ start, end }, sourceManager, languageOptions);
+        }
+
+        std::string absoluteIn(const std::string& directory, const std::string& filename) {
+            llvm::SmallString<256> absolute(filename);
+            if (!llvm::sys::path::is_absolute(absolute)) {
+                absolute = directory;
+                llvm::sys::path::append(absolute, filename);
+            }
+            llvm::sys::path::remove_dots(absolute, /*remove_dot_dot=*/true);
+            return absolute.str();
+        }
+
         std::string makeAbsolute(const std::string& filename) {
-            llvm::SmallString<256> absolutePath(filename);
-            const auto error = llvm::sys::fs::make_absolute(absolutePath);
+            llvm::SmallString<256> workingDirectory;
+            const auto error = llvm::sys::fs::current_path(workingDirectory);
             Routines::assertTrowIfFail(!error, "Error generating absolute path");
             (void)error;
-            llvm::sys::path::remove_dots(absolutePath, true);
-            return absolutePath.str();
+            return absoluteIn(workingDirectory.str(), filename);
+        }
+
+        std::string makeRelative(const std::string& filename) {
+            llvm::SmallString<256> workingDirectory;
+            llvm::sys::fs::current_path(workingDirectory);
+            llvm::StringRef path(filename);
+            if (path.startswith(workingDirectory) && path.drop_front(workingDirectory.size()).startswith("/"))
+                path = path.drop_front(workingDirectory.size() + 1);
+            return path.str();
+        }
+
+        std::size_t peakResidentBytes() {
+#if defined(_WIN32)
+            return 0;
+#else
+            struct rusage usage;
+            if (getrusage(RUSAGE_SELF, &usage) != 0)
+                return 0;
+#if defined(__APPLE__)
+            return static_cast<std::size_t>(usage.ru_maxrss);
+#else
+            // Linux reports kilobytes.
+            return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
         }
 
         void error(const char* message) {
@@ -0,0 +1,184 @@
+// Project includes
+#include "misra-tidy/common/unified-diff.hpp"
+
+// LLVM includes
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Standard includes
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace tidy {
+    namespace {
+        /// What to do with a line to get from the old contents to the new.
+        enum class Operation : char { kKeep, kRemove, kInsert };
+
+        /// Splits `text` into lines, each with its newline (if any).
+        std::vector<llvm::StringRef> linesOf(llvm::StringRef text) {
+            std::vector<llvm::StringRef> lines;
+            while (!text.empty()) {
+                const auto newline = text.find('\n');
+                const auto length = newline == llvm::StringRef::npos ? text.size() : newline + 1;
+                lines.push_back(text.take_front(length));
+                text = text.drop_front(length);
+            }
+            return lines;
+        }
+
+        /// Returns the shortest edit script turning `before` into `after`.
+        std::vector<Operation> editScript(llvm::ArrayRef<llvm::StringRef> before,
+            llvm::ArrayRef<llvm::StringRef> after) {
+            const int n = static_cast<int>(before.size());
+            const int m = static_cast<int>(after.size());
+            const int offset = n + m + 1;
+            std::vector<int> frontier(2 * offset + 1, 0);
+            std::vector<std::vector<int>> trace;
+
+            // Find how far each diagonal k = x - y gets with d edits.
+            bool done = n == 0 && m == 0;
+            for (int d = 0; !done && d <= n + m; ++d) {
+                trace.push_back(frontier);
+                for (int k = -d; k <= d; k += 2) {
+                    int x;
+                    if (k == -d || (k != d && frontier[offset + k - 1] < frontier[offset + k + 1]))
+                        x = frontier[offset + k + 1];
+                    else
+                        x = frontier[offset + k - 1] + 1;
+                    int y = x - k;
+                    while (x < n && y < m && before[x] == after[y]) {
+                        ++x;
+                        ++y;
+                    }
+                    frontier[offset + k] = x;
+                    if (x >= n && y >= m) {
+                        done = true;
+                        break;
+                    }
+                }
+            }
+
+            // Walk back from the end, one edit at a time.
+            std::vector<Operation> script;
+            int x = n;
+            int y = m;
+            for (int d = static_cast<int>(trace.size()) - 1; d >= 0; --d) {
+                const auto& previous = trace[d];
+                const int k = x - y;
+                const int previousK =
+                    (k == -d || (k != d && previous[offset + k - 1] < previous[offset + k + 1])) ? k + 1 : k - 1;
+                const int previousX = d == 0 ? 0 : previous[offset + previousK];
+                const int previousY = d == 0 ? 0 : previousX - previousK;
+                while (x > previousX && y > previousY) {
+                    script.push_back(Operation::kKeep);
+                    --x;
+                    --y;
+                }
+                if (d == 0)
+                    break;
+                script.push_back(x == previousX ? Operation::kInsert : Operation::kRemove);
+                x = previousX;
+                y = previousY;
+            }
+            std::reverse(script.begin(), script.end());
+            return script;
+        }
+
+        /// Writes `line` with its `prefix`, marking a missing final newline.
+        void writeLine(llvm::raw_ostream& out, char prefix, llvm::StringRef line) {
+            out << prefix << line;
+            if (!line.endswith("\n"))
+                out << "\n\\ No newline at end of file\n";
+        }
+
+        /// Writes the start and length of a hunk's range, as unified diffs do.
+        void writeRange(llvm::raw_ostream& out, std::size_t start, std::size_t length) {
+            out << (length == 0 ? start : start + 1);
+            if (length != 1)
+                out << ',' << length;
+        }
+    }  // namespace
+
+    void writeUnifiedDiff(llvm::raw_ostream& out,
+        llvm::StringRef name,
+        llvm::StringRef before,
+        llvm::StringRef after,
+        unsigned context) {
+        if (before == after)
+            return;
+        const auto oldLines = linesOf(before);
+        const auto newLines = linesOf(after);
+
+        std::size_t prefix = 0;
+        while (prefix < oldLines.size() && prefix < newLines.size() &&
+               oldLines[prefix] == newLines[prefix])
+            ++prefix;
+        std::size_t suffix = 0;
+        while (suffix < oldLines.size() - prefix && suffix < newLines.size() - prefix &&
+               oldLines[oldLines.size() - 1 - suffix] == newLines[newLines.size() - 1 - suffix])
+            ++suffix;
+
+        std::vector<Operation> script(prefix, Operation::kKeep);
+        const auto middle = editScript(
+            llvm::makeArrayRef(oldLines).slice(prefix, oldLines.size() - prefix - suffix),
+            llvm::makeArrayRef(newLines).slice(prefix, newLines.size() - prefix - suffix));
+        script.insert(script.end(), middle.begin(), middle.end());
+        script.insert(script.end(), suffix, Operation::kKeep);
+
+        out << "--- a/" << name << "\n+++ b/" << name << '\n';
+        std::size_t position = 0;
+        std::size_t oldLine = 0;
+        std::size_t newLine = 0;
+        while (position < script.size()) {
+            // Find the next change, then extend the hunk over every change at
+            // most twice the context away.
+            auto first = position;
+            while (first < script.size() && script[first] == Operation::kKeep)
+                ++first;
+            if (first == script.size())
+                break;
+            auto last = first;
+            for (auto it = first; it < script.size(); ++it) {
+                if (script[it] == Operation::kKeep)
+                    continue;
+                if (it > last + 2 * context + 1)
+                    break;
+                last = it;
+            }
+            const auto begin = first - std::min<std::size_t>(context, first - position);
+            const auto end = std::min(script.size(), last + 1 + context);
+
+            // Skip the unchanged lines before the hunk.
+            oldLine += begin - position;
+            newLine += begin - position;
+            std::size_t oldLength = 0;
+            std::size_t newLength = 0;
+            for (auto it = begin; it < end; ++it) {
+                oldLength += script[it] != Operation::kInsert;
+                newLength += script[it] != Operation::kRemove;
+            }
+            out << "@@ -";
+            writeRange(out, oldLine, oldLength);
+            out << " +";
+            writeRange(out, newLine, newLength);
+            out << " @@\n";
+            for (auto it = begin; it < end; ++it) {
+                switch (script[it]) {
+                case Operation::kKeep:
+                    writeLine(out, ' ', oldLines[oldLine++]);
+                    ++newLine;
+                    break;
+                case Operation::kRemove:
+                    writeLine(out, '-', oldLines[oldLine++]);
+                    break;
+                case Operation::kInsert:
+                    writeLine(out, '+', newLines[newLine++]);
+                    break;
+                }
+            }
+            position = end;
+        }
+    }
+
+}  // namespace tidy
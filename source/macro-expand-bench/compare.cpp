@@ -0,0 +1,287 @@
+// Project includes
+#include "compare.hpp"
+
+// Third-party includes
+#include <third-party/json.hpp>
+
+// LLVM includes
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Standard includes
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace tidy {
+    namespace Bench {
+        namespace {
+            llvm::cl::OptionCategory compareCategory("macro-expand-bench compare options");
+
+            llvm::cl::opt<std::string> baselineOption(llvm::cl::Positional,
+                llvm::cl::Required,
+                llvm::cl::desc("<baseline.json>"),
+                llvm::cl::cat(compareCategory));
+
+            llvm::cl::opt<std::string> currentOption(llvm::cl::Positional,
+                llvm::cl::Required,
+                llvm::cl::desc("<current.json>"),
+                llvm::cl::cat(compareCategory));
+
+            llvm::cl::opt<double> thresholdOption("threshold",
+                llvm::cl::init(5.0),
+                llvm::cl::value_desc("percent"),
+                llvm::cl::desc("Fail if a metric regresses significantly by more than this many percent"),
+                llvm::cl::cat(compareCategory));
+
+            /// Whether a larger value of a metric is an improvement or a regression.
+            enum class Direction { LowerIsBetter, HigherIsBetter };
+
+            /// All samples of one metric of one case.
+            struct Metric {
+                Direction direction;
+                std::vector<double> samples;
+            };
+
+            /// Samples by case name, then by metric name.
+            using Samples = std::map<std::string, std::map<std::string, Metric>>;
+
+            void addSample(Samples& samples,
+                const std::string& name,
+                const std::string& metric,
+                Direction direction,
+                double value) {
+                auto& entry = samples[name][metric];
+                entry.direction = direction;
+                entry.samples.push_back(value);
+            }
+
+            /// Converts a benchmark time in `unit` to nanoseconds.
+            double toNanoseconds(double value, const std::string& unit) {
+                if (unit == "us") return value * 1e3;
+                if (unit == "ms") return value * 1e6;
+                if (unit == "s") return value * 1e9;
+                return value;
+            }
+
+            /// Reads the (possibly repeated) runs of the benchmark JSON output.
+            /// Aggregates like `_mean` are skipped, since we compute our own.
+            void readBenchmarks(const nlohmann::json& json, Samples& samples) {
+                for (const auto& run : json["benchmarks"]) {
+                    if (run.count("error_occurred") && run["error_occurred"].get<bool>())
+                        continue;
+                    if (run.count("run_type") && run["run_type"] == "aggregate")
+                        continue;
+                    const auto name = run.count("run_name")
+                        ? run["run_name"].get<std::string>()
+                        : run["name"].get<std::string>();
+                    const llvm::StringRef ref(name);
+                    if (ref.endswith("_mean") || ref.endswith("_median") ||
+                        ref.endswith("_stddev") || ref.endswith("_cv"))
+                        continue;
+
+                    const auto unit = run.count("time_unit")
+                        ? run["time_unit"].get<std::string>()
+                        : std::string("ns");
+                    addSample(samples, name, "real_time_ns", Direction::LowerIsBetter,
+                        toNanoseconds(run["real_time"].get<double>(), unit));
+                    addSample(samples, name, "cpu_time_ns", Direction::LowerIsBetter,
+                        toNanoseconds(run["cpu_time"].get<double>(), unit));
+                    if (run.count("items_per_second")) {
+                        addSample(samples, name, "items_per_second", Direction::HigherIsBetter,
+                            run["items_per_second"].get<double>());
+                    }
+                }
+            }
+
+            /// Reads one run of `macro-expand -stats`.
+            void readStatistics(const nlohmann::json& json, Samples& samples) {
+                double expandSeconds = 0;
+                if (json.count("phases")) {
+                    for (auto phase = json["phases"].begin(); phase != json["phases"].end(); ++phase) {
+                        addSample(samples, "phase/" + phase.key(), "seconds",
+                            Direction::LowerIsBetter, phase.value().get<double>());
+                        if (phase.key() == "callsiteExpand")
+                            expandSeconds = phase.value().get<double>();
+                    }
+                }
+                if (expandSeconds > 0) {
+                    addSample(samples, "run", "translation_units_per_second",
+                        Direction::HigherIsBetter,
+                        json["translationUnits"].get<double>() / expandSeconds);
+                }
+                if (json.count("peakResidentBytes") && json["peakResidentBytes"].get<double>() > 0) {
+                    addSample(samples, "run", "peak_resident_bytes",
+                        Direction::LowerIsBetter, json["peakResidentBytes"].get<double>());
+                }
+            }
+
+            /// Reads either benchmark JSON output or `-stats` lines (one JSON object
+            /// per line, one line per run) from `filename`.
+            bool readSamples(const std::string& filename, Samples& samples) {
+                auto buffer = llvm::MemoryBuffer::getFile(filename);
+                if (!buffer) {
+                    llvm::errs() << "Could not read " << filename << ": "
+                                 << buffer.getError().message() << '\n';
+                    return false;
+                }
+
+                const auto text = (*buffer)->getBuffer();
+                if (text.find("\"benchmarks\"") != llvm::StringRef::npos) {
+                    readBenchmarks(nlohmann::json::parse(text.str()), samples);
+                    return true;
+                }
+
+                llvm::SmallVector<llvm::StringRef, 16> lines;
+                text.split(lines, '\n', /*MaxSplit=*/-1, /*KeepEmpty=*/false);
+                for (const auto& line : lines) {
+                    if (line.trim().empty()) continue;
+                    readStatistics(nlohmann::json::parse(line.str()), samples);
+                }
+                return true;
+            }
+
+            /// The two-sided 95% critical value of Student's t-distribution. Rounding
+            /// the degrees of freedom down keeps the interval conservative.
+            double criticalValue(double degreesOfFreedom) {
+                static const double table[] = {
+                    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+                };
+                const auto df = static_cast<long>(std::floor(degreesOfFreedom));
+                if (df < 1) return table[0];
+                if (df <= 30) return table[df - 1];
+                if (df <= 40) return 2.021;
+                if (df <= 60) return 2.000;
+                if (df <= 120) return 1.980;
+                return 1.960;
+            }
+
+            double mean(const std::vector<double>& samples) {
+                double sum = 0;
+                for (const auto sample : samples) sum += sample;
+                return sum / samples.size();
+            }
+
+            double variance(const std::vector<double>& samples, double average) {
+                if (samples.size() < 2) return 0;
+                double sum = 0;
+                for (const auto sample : samples) sum += (sample - average) * (sample - average);
+                return sum / (samples.size() - 1);
+            }
+
+            /// The comparison of one metric between baseline and current.
+            struct Delta {
+                double baseline;
+                double current;
+
+                /// The relative change of the mean, in percent of the baseline.
+                double percent;
+
+                /// Half the width of the 95% confidence interval of `percent`, or a
+                /// negative value if there are too few samples for an interval.
+                double margin;
+
+                bool significant;
+                bool regression;
+            };
+
+            Delta compareMetric(const Metric& baseline, const Metric& current) {
+                Delta delta;
+                delta.baseline = mean(baseline.samples);
+                delta.current = mean(current.samples);
+                const auto difference = delta.current - delta.baseline;
+                delta.percent = delta.baseline != 0 ? 100 * difference / delta.baseline : 0;
+
+                const auto n1 = static_cast<double>(baseline.samples.size());
+                const auto n2 = static_cast<double>(current.samples.size());
+                if (n1 >= 2 && n2 >= 2) {
+                    const auto v1 = variance(baseline.samples, delta.baseline) / n1;
+                    const auto v2 = variance(current.samples, delta.current) / n2;
+                    const auto standardError = std::sqrt(v1 + v2);
+                    // Welch-Satterthwaite approximation of the degrees of freedom.
+                    const auto df = standardError > 0
+                        ? (v1 + v2) * (v1 + v2) / (v1 * v1 / (n1 - 1) + v2 * v2 / (n2 - 1))
+                        : n1 + n2 - 2;
+                    const auto halfWidth = criticalValue(df) * standardError;
+                    delta.margin = delta.baseline != 0 ? 100 * halfWidth / std::fabs(delta.baseline) : 0;
+                    delta.significant = std::fabs(difference) > halfWidth;
+                }
+                else {
+                    // With single runs there is no interval; fall back to the raw delta.
+                    delta.margin = -1;
+                    delta.significant = true;
+                }
+
+                const bool worse = baseline.direction == Direction::LowerIsBetter
+                    ? difference > 0
+                    : difference < 0;
+                delta.regression = delta.significant && worse &&
+                    std::fabs(delta.percent) > thresholdOption;
+                return delta;
+            }
+        }  // namespace
+
+        int compare(int argc, const char* const* argv) {
+            llvm::cl::HideUnrelatedOptions(compareCategory);
+            llvm::cl::ParseCommandLineOptions(argc, argv,
+                "Compares two benchmark or -stats outputs of macro-expand\n");
+
+            Samples baseline;
+            Samples current;
+            if (!readSamples(baselineOption, baseline) || !readSamples(currentOption, current))
+                return 2;
+
+            auto& out = llvm::outs();
+            const char* const columns[] = {
+                "case", "metric", "baseline", "current", "delta", "95% CI"
+            };
+            out << llvm::format("%-60s %-30s %14s %14s %9s %18s\n",
+                columns[0], columns[1], columns[2], columns[3], columns[4], columns[5]);
+
+            unsigned regressions = 0;
+            for (const auto& name : current) {
+                const auto baselineCase = baseline.find(name.first);
+                if (baselineCase == baseline.end()) continue;
+                for (const auto& metric : name.second) {
+                    const auto baselineMetric = baselineCase->second.find(metric.first);
+                    if (baselineMetric == baselineCase->second.end()) continue;
+
+                    const auto delta = compareMetric(baselineMetric->second, metric.second);
+                    std::string interval = "n/a";
+                    if (delta.margin >= 0) {
+                        llvm::raw_string_ostream stream(interval = std::string());
+                        stream << llvm::format("[%+.1f%%, %+.1f%%]",
+                            delta.percent - delta.margin, delta.percent + delta.margin);
+                        stream.flush();
+                    }
+                    out << llvm::format("%-60s %-30s %14.4g %14.4g %+8.1f%% %18s",
+                        name.first.c_str(), metric.first.c_str(),
+                        delta.baseline, delta.current, delta.percent, interval.c_str());
+                    if (delta.regression) {
+                        out << "  REGRESSION";
+                        ++regressions;
+                    }
+                    else if (delta.significant && delta.margin >= 0) {
+                        out << "  significant";
+                    }
+                    out << '\n';
+                }
+            }
+
+            if (regressions > 0) {
+                out << regressions << " metric(s) regressed by more than "
+                    << llvm::format("%.1f", static_cast<double>(thresholdOption)) << "%\n";
+                return 1;
+            }
+            return 0;
+        }
+
+    }  // namespace Bench
+}  // namespace tidy
@@ -0,0 +1,26 @@
+#ifndef MACRO_EXPAND_BENCH_COMPARE_HPP
+#define MACRO_EXPAND_BENCH_COMPARE_HPP
+
+namespace tidy {
+    namespace Bench {
+
+        /// Runs the `compare` subcommand: `macro-expand-bench compare <baseline>
+        /// <current> [-threshold=<percent>]`.
+        ///
+        /// Both files may either be the JSON output of the benchmarks
+        /// (`--benchmark_out=<file> --benchmark_repetitions=<n>`) or the output of
+        /// one or more `macro-expand -stats=<file>` runs. Repeated runs of the same
+        /// case are treated as samples: the mean difference of every metric is
+        /// reported with a 95% confidence interval (Welch's t-test), and a change is
+        /// considered significant if the interval excludes zero.
+        ///
+        /// `argv[0]` is the name of the subcommand.
+        ///
+        /// \returns The exit code of the process, which is nonzero if any metric
+        /// regressed significantly by more than the threshold.
+        int compare(int argc, const char* const* argv);
+
+    }  // namespace Bench
+}  // namespace tidy
+
+#endif  // MACRO_EXPAND_BENCH_COMPARE_HPP
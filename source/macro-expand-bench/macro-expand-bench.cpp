@@ -0,0 +1,280 @@
+// Project includes
+#include "misra-tidy/common/routines.hpp"
+#include "misra-tidy/macro-expand/macro-search.hpp"
+#include "misra-tidy/macro-expand/options.hpp"
+#include "misra-tidy/macro-expand/query.hpp"
+#include "compare.hpp"
+#include "macro-shapes.hpp"
+
+// Third-party includes
+#include <benchmark/benchmark.h>
+
+// Clang includes
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/FrontendActions.h>
+#include <clang/Lex/MacroArgs.h>
+#include <clang/Lex/MacroInfo.h>
+#include <clang/Lex/PPCallbacks.h>
+#include <clang/Lex/Preprocessor.h>
+#include <clang/Lex/Token.h>
+#include <clang/Tooling/Tooling.h>
+
+// LLVM includes
+#include <llvm/ADT/StringRef.h>
+
+// Standard includes
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace tidy {
+    namespace MacroExpand {
+
+        /// Forwards to the private hot paths of `MacroSearch`, so that each one can
+        /// be timed on its own.
+        struct MacroSearchAccess {
+            using ParameterMap = MacroSearch::ParameterMap;
+
+            static ParameterMap createParameterMap(MacroSearch& search,
+                const clang::MacroInfo& info,
+                const clang::MacroArgs& arguments) {
+                return search._createParameterMap(info, arguments);
+            }
+
+            static std::string rewriteMacro(MacroSearch& search,
+                const clang::MacroInfo& info,
+                const ParameterMap& mapping) {
+                return search._rewriteMacro(info, mapping);
+            }
+
+            static std::string getSpelling(const MacroSearch& search,
+                const clang::Token& token) {
+                return search._getSpelling(token);
+            }
+
+            static std::string getDefinitionText(MacroSearch& search,
+                const clang::MacroInfo& info) {
+                return Routines::getDefinitionText(info,
+                    search._sourceManager,
+                    search._languageOptions);
+            }
+        };
+
+    }  // namespace MacroExpand
+}  // namespace tidy
+
+namespace {
+    using tidy::MacroExpand::MacroSearch;
+    using tidy::MacroExpand::MacroSearchAccess;
+
+    /// The `MacroSearch` hot path a benchmark measures.
+    enum class HotPath {
+        CreateParameterMap,
+        RewriteMacro,
+        DefinitionText,
+        Spelling,
+        EndOfMainFile
+    };
+
+    /// Preprocessor hooks that run the timed loop of a benchmark from inside the
+    /// callback, while the `clang::MacroInfo` and `clang::MacroArgs` the hot path
+    /// needs are still alive. They are installed after (and thus run before) the
+    /// `MacroSearch` hooks they measure.
+    class Probe : public clang::PPCallbacks {
+    public:
+        Probe(benchmark::State& state,
+            HotPath path,
+            MacroSearch& search,
+            tidy::UnitRecords& records)
+            : _state(state)
+            , _path(path)
+            , _search(search)
+            , _records(records) {
+        }
+
+        void MacroExpands(const clang::Token& macroNameToken,
+            const clang::MacroDefinition& macro,
+            clang::SourceRange,
+            const clang::MacroArgs* arguments) override {
+            if (_path == HotPath::EndOfMainFile || !arguments ||
+                macroNameToken.getIdentifierInfo()->getName() != tidy::Bench::kMacroName)
+                return;
+
+            const auto& info = *macro.getMacroInfo();
+            switch (_path) {
+            case HotPath::CreateParameterMap:
+                for (auto _ : _state) {
+                    benchmark::DoNotOptimize(
+                        MacroSearchAccess::createParameterMap(_search, info, *arguments));
+                }
+                break;
+            case HotPath::RewriteMacro: {
+                const auto mapping =
+                    MacroSearchAccess::createParameterMap(_search, info, *arguments);
+                for (auto _ : _state) {
+                    benchmark::DoNotOptimize(
+                        MacroSearchAccess::rewriteMacro(_search, info, mapping));
+                }
+                break;
+            }
+            case HotPath::DefinitionText:
+                for (auto _ : _state) {
+                    benchmark::DoNotOptimize(
+                        MacroSearchAccess::getDefinitionText(_search, info));
+                }
+                break;
+            case HotPath::Spelling:
+                for (auto _ : _state) {
+                    benchmark::DoNotOptimize(
+                        MacroSearchAccess::getSpelling(_search, macroNameToken));
+                }
+                break;
+            case HotPath::EndOfMainFile:
+                break;
+            }
+            _ran = true;
+        }
+
+        void EndOfMainFile() override {
+            if (_path != HotPath::EndOfMainFile)
+                return;
+            // Every iteration removes the same unused definitions again, so it needs
+            // pristine records.
+            for (auto _ : _state) {
+                _state.PauseTiming();
+                _records.removals.clear();
+                _state.ResumeTiming();
+                _search.EndOfMainFile();
+            }
+            _ran = true;
+        }
+
+        /// Whether the timed loop was run at all.
+        bool ran() const noexcept {
+            return _ran;
+        }
+
+    private:
+        benchmark::State& _state;
+        HotPath _path;
+        MacroSearch& _search;
+        tidy::UnitRecords& _records;
+        bool _ran = false;
+    };
+
+    /// Preprocesses a generated translation unit with `MacroSearch` and a `Probe`
+    /// installed.
+    class BenchAction : public clang::PreprocessOnlyAction {
+    public:
+        BenchAction(benchmark::State& state, HotPath path, bool& ran)
+            : _state(state)
+            , _path(path)
+            , _ran(ran)
+            , _query(tidy::Options{ true, true, true, false }) {
+        }
+
+        bool BeginSourceFileAction(clang::CompilerInstance& compiler,
+            llvm::StringRef) override {
+            auto search = std::make_unique<MacroSearch>(compiler, _query, _records);
+            auto probe = std::make_unique<Probe>(_state, _path, *search, _records);
+            _probe = probe.get();
+            compiler.getPreprocessor().addPPCallbacks(std::move(search));
+            compiler.getPreprocessor().addPPCallbacks(std::move(probe));
+            return true;
+        }
+
+        void EndSourceFileAction() override {
+            _ran = _probe && _probe->ran();
+        }
+
+    private:
+        benchmark::State& _state;
+        HotPath _path;
+        bool& _ran;
+        tidy::Query _query;
+        tidy::UnitRecords _records;
+        const Probe* _probe = nullptr;
+    };
+
+    /// Runs the benchmark of `path` on the generated `source`.
+    void run(benchmark::State& state, HotPath path, const std::string& source) {
+        bool ran = false;
+        const bool ok = clang::tooling::runToolOnCodeWithArgs(
+            new BenchAction(state, path, ran), source, { "-std=c++14" }, "bench.cpp");
+        if (!ok || !ran) {
+            state.SkipWithError("The generated source did not reach the hot path");
+            return;
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    tidy::Bench::MacroShape shapeOf(const benchmark::State& state) {
+        return { static_cast<unsigned>(state.range(0)),
+                 static_cast<unsigned>(state.range(1)),
+                 static_cast<unsigned>(state.range(2)) };
+    }
+
+    void BM_CreateParameterMap(benchmark::State& state) {
+        run(state,
+            HotPath::CreateParameterMap,
+            tidy::Bench::makeFunctionMacroSource(shapeOf(state)));
+    }
+
+    void BM_RewriteMacro(benchmark::State& state) {
+        run(state,
+            HotPath::RewriteMacro,
+            tidy::Bench::makeFunctionMacroSource(shapeOf(state)));
+    }
+
+    void BM_GetDefinitionText(benchmark::State& state) {
+        run(state,
+            HotPath::DefinitionText,
+            tidy::Bench::makeFunctionMacroSource(shapeOf(state)));
+    }
+
+    void BM_GetSpelling(benchmark::State& state) {
+        run(state,
+            HotPath::Spelling,
+            tidy::Bench::makeFunctionMacroSource(shapeOf(state)));
+    }
+
+    void BM_EndOfMainFile(benchmark::State& state) {
+        run(state,
+            HotPath::EndOfMainFile,
+            tidy::Bench::makeDefinitionsSource(static_cast<unsigned>(state.range(0)),
+                static_cast<unsigned>(state.range(1))));
+    }
+
+    /// Argument counts x tokens per argument x stringify/paste density.
+    void functionMacroShapes(benchmark::internal::Benchmark* benchmark) {
+        benchmark->ArgNames({ "args", "tokens", "density" });
+        for (int arguments : { 1, 4, 16 })
+            for (int tokens : { 1, 8, 64 })
+                for (int density : { 0, 50, 100 })
+                    benchmark->Args({ arguments, tokens, density });
+    }
+
+    /// Number of definitions x stride of used definitions (0 = none used).
+    void definitionShapes(benchmark::internal::Benchmark* benchmark) {
+        benchmark->ArgNames({ "definitions", "usedEvery" });
+        for (int definitions : { 16, 256, 4096 })
+            for (int usedEvery : { 0, 1, 2, 16 })
+                benchmark->Args({ definitions, usedEvery });
+    }
+}  // namespace
+
+BENCHMARK(BM_CreateParameterMap)->Apply(functionMacroShapes);
+BENCHMARK(BM_RewriteMacro)->Apply(functionMacroShapes);
+BENCHMARK(BM_GetDefinitionText)->Apply(functionMacroShapes);
+BENCHMARK(BM_GetSpelling)->Args({ 1, 1, 0 });
+BENCHMARK(BM_EndOfMainFile)->Apply(definitionShapes);
+
+auto main(int argc, char* argv[]) -> int {
+    if (argc > 1 && llvm::StringRef(argv[1]) == "compare")
+        return tidy::Bench::compare(argc - 1, argv + 1);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,71 @@
+// Project includes
+#include "macro-shapes.hpp"
+
+// Standard includes
+#include <string>
+
+namespace tidy {
+    namespace Bench {
+        const char* const kMacroName = "BENCH_MACRO";
+
+        std::string makeFunctionMacroSource(const MacroShape& shape) {
+            std::string source = "#define ";
+            source += kMacroName;
+            source += '(';
+            for (unsigned parameter = 0; parameter < shape.arguments; ++parameter) {
+                if (parameter > 0) source += ", ";
+                source += 'p' + std::to_string(parameter);
+            }
+            source += ") {";
+
+            // Spread the stringify/paste operators evenly over the parameter uses,
+            // Bresenham-style, so that e.g. a density of 25 decorates every fourth use.
+            unsigned accumulated = 0;
+            bool stringify = true;
+            for (unsigned use = 0; use < shape.tokens; ++use) {
+                for (unsigned parameter = 0; parameter < shape.arguments; ++parameter) {
+                    const auto name = 'p' + std::to_string(parameter);
+                    source += ' ';
+                    accumulated += shape.density;
+                    if (accumulated >= 100) {
+                        accumulated -= 100;
+                        source += stringify ? "#" + name : name + " ## _" + std::to_string(use);
+                        stringify = !stringify;
+                    }
+                    else {
+                        source += name;
+                    }
+                    source += ',';
+                }
+            }
+            source += " }\n";
+
+            source += kMacroName;
+            source += '(';
+            for (unsigned argument = 0; argument < shape.arguments; ++argument) {
+                if (argument > 0) source += ", ";
+                for (unsigned token = 0; token < shape.tokens; ++token) {
+                    if (token > 0) source += ' ';
+                    source += 'a' + std::to_string(argument) + '_' + std::to_string(token);
+                }
+            }
+            source += ")\n";
+
+            return source;
+        }
+
+        std::string makeDefinitionsSource(unsigned definitions, unsigned usedEvery) {
+            std::string source;
+            for (unsigned index = 0; index < definitions; ++index) {
+                source += "#define DEFINITION_" + std::to_string(index) + ' ' +
+                          std::to_string(index) + '\n';
+            }
+            for (unsigned index = 0; usedEvery > 0 && index < definitions; index += usedEvery) {
+                source += "int use_" + std::to_string(index) + " = DEFINITION_" +
+                          std::to_string(index) + ";\n";
+            }
+            return source;
+        }
+
+    }  // namespace Bench
+}  // namespace tidy
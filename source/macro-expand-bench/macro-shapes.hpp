@@ -0,0 +1,40 @@
+#ifndef MACRO_EXPAND_BENCH_MACRO_SHAPES_HPP
+#define MACRO_EXPAND_BENCH_MACRO_SHAPES_HPP
+
+// Standard includes
+#include <string>
+
+namespace tidy {
+    namespace Bench {
+
+        /// The name of the macro every generated source defines and invokes
+        /// exactly once. The benchmarks hook the expansion of this macro.
+        extern const char* const kMacroName;
+
+        /// Describes the shape of the function-like macro a benchmark runs on.
+        struct MacroShape {
+            /// The number of parameters of the macro (and arguments at the call).
+            unsigned arguments;
+
+            /// The number of tokens spelled in each argument at the call site. The
+            /// replacement list uses every parameter this many times as well.
+            unsigned tokens;
+
+            /// The percentage (0-100) of parameter uses in the replacement list that
+            /// are stringified (`#a`) or pasted (`a ## b`), alternating between the
+            /// two.
+            unsigned density;
+        };
+
+        /// Generates a translation unit that defines and invokes `kMacroName` with
+        /// the given shape.
+        std::string makeFunctionMacroSource(const MacroShape& shape);
+
+        /// Generates a translation unit with `definitions` object-like macros, of
+        /// which every `usedEvery`-th one is expanded and the rest are unused.
+        std::string makeDefinitionsSource(unsigned definitions, unsigned usedEvery);
+
+    }  // namespace Bench
+}  // namespace tidy
+
+#endif  // MACRO_EXPAND_BENCH_MACRO_SHAPES_HPP
@@ -0,0 +1,114 @@
+// Project includes
+#include "misra-tidy/common/routines.hpp"
+#include "file-watcher.hpp"
+
+// LLVM includes
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/Path.h>
+
+// Standard includes
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace tidy {
+#if defined(__linux__)
+    FileWatcher::FileWatcher()
+        : _descriptor(inotify_init1(IN_CLOEXEC)) {
+        if (_descriptor < 0)
+            throw Routines::ErrorCode{ "could not initialize inotify" };
+    }
+
+    FileWatcher::~FileWatcher() {
+        close(_descriptor);
+    }
+
+    void FileWatcher::watchDirectoryOf(llvm::StringRef file) {
+        const auto directory = llvm::sys::path::parent_path(file);
+        if (directory.empty() || !_watched.insert(directory).second)
+            return;
+        const auto watch = inotify_add_watch(_descriptor, directory.str().c_str(),
+            IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+        if (watch >= 0)
+            _directories[watch] = directory.str();
+    }
+
+    void FileWatcher::ignore(llvm::StringRef file) {
+        const auto path = Routines::makeAbsolute(file.str());
+        _ignored.insert(path);
+        _ignored.insert(path + ".tmp");
+    }
+
+    FileWatcher::Changes FileWatcher::wait(std::chrono::milliseconds quiet) {
+        Changes changes;
+        while (changes.paths.empty() && !changes.overflowed) {
+            _read(-1, changes);
+            while (_read(static_cast<int>(quiet.count()), changes)) {
+            }
+        }
+        std::sort(changes.paths.begin(), changes.paths.end());
+        changes.paths.erase(std::unique(changes.paths.begin(), changes.paths.end()),
+            changes.paths.end());
+        return changes;
+    }
+
+    bool FileWatcher::_read(int timeout, Changes& changes) {
+        pollfd descriptor{ _descriptor, POLLIN, 0 };
+        int ready;
+        while ((ready = poll(&descriptor, 1, timeout)) < 0 && errno == EINTR) {
+        }
+        if (ready <= 0)
+            return false;
+
+        alignas(inotify_event) char buffer[16 * 1024];
+        const auto length = read(_descriptor, buffer, sizeof(buffer));
+        if (length <= 0)
+            return false;
+        for (const char* it = buffer; it < buffer + length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(it);
+            it += sizeof(inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                changes.overflowed = true;
+                continue;
+            }
+            const auto directory = _directories.find(event->wd);
+            if (directory == _directories.end() || event->len == 0)
+                continue;
+            llvm::SmallString<256> path(directory->second);
+            llvm::sys::path::append(path, event->name);
+            if (!_ignored.count(path))
+                changes.paths.push_back(path.str().str());
+        }
+        return true;
+    }
+#else
+    FileWatcher::FileWatcher() {
+        throw Routines::ErrorCode{ "-watch is only supported on Linux" };
+    }
+
+    FileWatcher::~FileWatcher() {
+    }
+
+    void FileWatcher::watchDirectoryOf(llvm::StringRef) {
+    }
+
+    void FileWatcher::ignore(llvm::StringRef) {
+    }
+
+    FileWatcher::Changes FileWatcher::wait(std::chrono::milliseconds) {
+        return {};
+    }
+
+    bool FileWatcher::_read(int, Changes&) {
+        return false;
+    }
+#endif
+}  // namespace tidy
@@ -0,0 +1,66 @@
+#ifndef MACRO_EXPAND_FILE_WATCHER_HPP
+#define MACRO_EXPAND_FILE_WATCHER_HPP
+
+// LLVM includes
+#include <llvm/ADT/StringSet.h>
+
+// Standard includes
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tidy {
+    /// Waits for files to change, using inotify.
+    ///
+    /// inotify watches directories, so watching a file watches every entry of
+    /// its directory; creating, writing, renaming or deleting any of them is
+    /// reported. Only available on Linux: elsewhere, the constructor throws.
+    class FileWatcher {
+    public:
+        /// What changed while `wait()` waited.
+        struct Changes {
+            /// The absolute paths that changed, sorted and without duplicates.
+            std::vector<std::string> paths;
+
+            /// Whether the kernel dropped events, so anything may have changed.
+            bool overflowed = false;
+        };
+
+        FileWatcher();
+        FileWatcher(const FileWatcher&) = delete;
+        FileWatcher& operator=(const FileWatcher&) = delete;
+        ~FileWatcher();
+
+        /// Watches the directory of the absolute `file`, unless already watched.
+        void watchDirectoryOf(llvm::StringRef file);
+
+        /// Never reports changes to `file`, or to the temporary it is saved to
+        /// first, such as the files the watching process writes itself.
+        void ignore(llvm::StringRef file);
+
+        /// Blocks until something other than the ignored files changes, then
+        /// collects further changes until none arrives for `quiet`, since
+        /// saving a file often takes several writes and renames.
+        Changes wait(std::chrono::milliseconds quiet);
+
+    private:
+        /// Reads the pending events into `changes`. Returns false if none
+        /// arrived within `timeout` (-1 to block).
+        bool _read(int timeout, Changes& changes);
+
+        /// The inotify instance.
+        int _descriptor = -1;
+
+        /// The directory of each watch descriptor.
+        std::unordered_map<int, std::string> _directories;
+
+        /// The directories watched so far, including those that could not be.
+        llvm::StringSet<> _watched;
+
+        /// The absolute paths whose changes are not reported.
+        llvm::StringSet<> _ignored;
+    };
+}  // namespace tidy
+
+#endif  // MACRO_EXPAND_FILE_WATCHER_HPP
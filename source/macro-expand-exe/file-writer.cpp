@@ -0,0 +1,134 @@
+// Project includes
+#include "misra-tidy/common/probes.hpp"
+#include "misra-tidy/common/routines.hpp"
+#include "file-writer.hpp"
+
+// LLVM includes
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Standard includes
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+
+// System includes
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
+
+namespace tidy {
+
+    FileWriter::FileWriter(std::size_t capacity, Written written)
+        : _written(std::move(written))
+        , _capacity(capacity)
+        , _thread(&FileWriter::_drain, this) {
+    }
+
+    FileWriter::~FileWriter() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _finished = true;
+        }
+        _changed.notify_all();
+        if (_thread.joinable())
+            _thread.join();
+    }
+
+    void FileWriter::write(std::string path, std::string contents) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        // A file larger than the whole buffer still goes through, alone.
+        _changed.wait(lock, [&] {
+            return !_error.empty() || _queue.empty() || _queuedBytes + contents.size() <= _capacity;
+        });
+        if (!_error.empty())
+            throw Routines::ErrorCode{ _error };
+        _queuedBytes += contents.size();
+        _queue.emplace_back(std::move(path), std::move(contents));
+        lock.unlock();
+        _changed.notify_all();
+    }
+
+    void FileWriter::finish() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _finished = true;
+        }
+        _changed.notify_all();
+        if (_thread.joinable())
+            _thread.join();
+        if (!_error.empty())
+            throw Routines::ErrorCode{ _error };
+    }
+
+    std::string FileWriter::_replace(const std::string& path, const std::string& contents) {
+        // Renaming a complete temporary over the file leaves it with either
+        // its old or its new contents, wherever the run is killed. A symbolic
+        // link stays one: the file it points to is replaced.
+        llvm::SmallString<256> target;
+        if (llvm::sys::fs::real_path(path, target))
+            target = path;
+        const auto temporary = target.str().str() + ".macro-expand.tmp";
+        {
+            std::error_code code;
+            llvm::raw_fd_ostream stream(temporary, code, llvm::sys::fs::F_None);
+            if (code)
+                return "could not write " + temporary + ": " + code.message();
+            stream << contents;
+            stream.close();
+            if (stream.has_error()) {
+                stream.clear_error();
+                llvm::sys::fs::remove(temporary);
+                return "could not write " + temporary;
+            }
+        }
+#if !defined(_WIN32)
+        // Windows has no permissions beyond read-only, which a rewritten file
+        // is not.
+        llvm::sys::fs::file_status status;
+        if (!llvm::sys::fs::status(target, status))
+            ::chmod(temporary.c_str(), status.permissions());
+#endif
+        if (const auto code = llvm::sys::fs::rename(temporary, target)) {
+            llvm::sys::fs::remove(temporary);
+            return "could not write " + path + ": " + code.message();
+        }
+        return std::string();
+    }
+
+    void FileWriter::_drain() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        for (;;) {
+            _changed.wait(lock, [this] { return _finished || !_queue.empty(); });
+            if (_queue.empty())
+                return;
+            auto file = std::move(_queue.front());
+            _queue.pop_front();
+
+            // Keep the bytes counted until written, so the buffer really caps
+            // the memory held.
+            lock.unlock();
+            std::string error;
+            if (_error.empty()) {
+                TIDY_PROBE2(file__write, file.first.c_str(), file.second.size());
+                error = _replace(file.first, file.second);
+                if (error.empty() && _written) {
+                    try {
+                        _written(file.first);
+                    }
+                    catch (const Routines::ErrorCode& failure) {
+                        error = failure.message;
+                    }
+                }
+            }
+            lock.lock();
+
+            if (!error.empty() && _error.empty())
+                _error = std::move(error);
+            _queuedBytes -= file.second.size();
+            _changed.notify_all();
+        }
+    }
+}  // namespace tidy
@@ -0,0 +1,87 @@
+#ifndef MACRO_EXPAND_FILE_WRITER_HPP
+#define MACRO_EXPAND_FILE_WRITER_HPP
+
+// Standard includes
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace tidy {
+    /// Writes files on a thread of its own.
+    ///
+    /// Each file is written to a temporary next to it, which is then renamed
+    /// over it, so an interrupted run never leaves a file half written.
+    ///
+    /// Threads rewriting files hand the finished contents over and go on with
+    /// the next file instead of waiting for the disk, which on a network file
+    /// system may take longer than the rewriting. At most `capacity` bytes
+    /// wait to be written; a thread handing over more blocks until the writer
+    /// catches up, so memory stays capped however slow the disk.
+    class FileWriter {
+    public:
+        /// Called on the writer thread once a file is written. May throw
+        /// `Routines::ErrorCode`, which fails the write.
+        using Written = std::function<void(const std::string&)>;
+
+        /// Starts the writer thread, buffering up to `capacity` bytes.
+        FileWriter(std::size_t capacity, Written written);
+
+        /// Waits for the files handed over so far, ignoring failures; call
+        /// `finish()` to see them.
+        ~FileWriter();
+
+        FileWriter(const FileWriter&) = delete;
+        FileWriter& operator=(const FileWriter&) = delete;
+
+        /// Hands `contents` over to be written to `path`, blocking while the
+        /// buffer is full. Throws `Routines::ErrorCode` if an earlier write
+        /// failed.
+        void write(std::string path, std::string contents);
+
+        /// Waits until every file handed over is written. Throws
+        /// `Routines::ErrorCode` if any write failed.
+        void finish();
+
+    private:
+        /// Writes the handed over files until finished.
+        void _drain();
+
+        /// Replaces the file at `path` with one of `contents`.
+        /// \returns why that failed, or empty.
+        static std::string _replace(const std::string& path, const std::string& contents);
+
+        /// Calls `_written` for every file written.
+        Written _written;
+
+        /// The number of bytes that may wait to be written.
+        std::size_t _capacity;
+
+        /// Guards everything below.
+        std::mutex _mutex;
+
+        /// Signals a file handed over, a file written, or the end.
+        std::condition_variable _changed;
+
+        /// The files waiting to be written, by path.
+        std::deque<std::pair<std::string, std::string>> _queue;
+
+        /// The bytes in `_queue`.
+        std::size_t _queuedBytes = 0;
+
+        /// Whether no more files will be handed over.
+        bool _finished = false;
+
+        /// Why the first failed write failed, or empty.
+        std::string _error;
+
+        /// Writes the files, started last so everything above is ready.
+        std::thread _thread;
+    };
+}  // namespace tidy
+
+#endif  // MACRO_EXPAND_FILE_WRITER_HPP
@@ -0,0 +1,296 @@
+// Project includes
+#include "misra-tidy/common/call-data.hpp"
+#include "misra-tidy/common/definition-data.hpp"
+#include "misra-tidy/common/location.hpp"
+#include "misra-tidy/common/range.hpp"
+#include "misra-tidy/common/routines.hpp"
+#include "misra-tidy/macro-expand/definition-table.hpp"
+#include "misra-tidy/macro-expand/query.hpp"
+#include "misra-tidy/macro-expand/statistics.hpp"
+#include "journal.hpp"
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// Clang includes
+#include <clang/Tooling/Core/Replacement.h>
+
+// LLVM includes
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Standard includes
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// System includes
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace tidy {
+    namespace {
+        nlohmann::json toJson(const clang::tooling::Replacement& replacement) {
+            // clang-format off
+            return {
+                {"file", replacement.getFilePath().str()},
+                {"offset", replacement.getOffset()},
+                {"length", replacement.getLength()},
+                {"text", replacement.getReplacementText().str()}
+            };
+            // clang-format on
+        }
+
+        clang::tooling::Replacement replacementOf(const nlohmann::json& json) {
+            return clang::tooling::Replacement(json.at("file").get<std::string>(),
+                json.at("offset").get<unsigned>(),
+                json.at("length").get<unsigned>(),
+                json.at("text").get<std::string>());
+        }
+
+        Offset offsetOf(const nlohmann::json& json) {
+            return Offset(json.at("line").get<unsigned>(), json.at("column").get<unsigned>());
+        }
+
+        Location locationOf(const nlohmann::json& json) {
+            const auto offset = offsetOf(json.at("offset"));
+            return Location(json.at("filename").get<std::string>(), offset.line, offset.column);
+        }
+
+        /// Returns the hex MD5 digest of `data`.
+        std::string md5Of(llvm::StringRef data) {
+            llvm::MD5 hash;
+            hash.update(data);
+            llvm::MD5::MD5Result result;
+            hash.final(result);
+            llvm::SmallString<32> hex;
+            llvm::MD5::stringifyResult(result, hex);
+            return hex.str();
+        }
+
+        /// Flushes what was written to `descriptor` to disk.
+        bool syncToDisk(int descriptor) {
+#if defined(_WIN32)
+            return ::_commit(descriptor) == 0;
+#else
+            return ::fsync(descriptor) == 0;
+#endif
+        }
+
+    }  // namespace
+
+    Journal::Journal(const std::string& directory, const nlohmann::json& options) {
+        if (const auto error = llvm::sys::fs::create_directories(directory))
+            throw Routines::ErrorCode{ "could not create " + directory + ": " + error.message() };
+        llvm::SmallString<256> filename(directory);
+        llvm::sys::path::append(filename, "journal.jsonl");
+        _filename = filename.str();
+
+        std::vector<nlohmann::json> entries;
+        bool endsWithNewline = true;
+        if (auto buffer = llvm::MemoryBuffer::getFile(_filename)) {
+            llvm::StringRef rest = (*buffer)->getBuffer();
+            endsWithNewline = rest.empty() || rest.back() == '\n';
+            while (!rest.empty()) {
+                const auto split = rest.split('\n');
+                rest = split.second;
+                try {
+                    entries.push_back(nlohmann::json::parse(split.first.str()));
+                }
+                catch (const std::exception&) {
+                    // Cut off by the interruption.
+                }
+            }
+        }
+
+        // The records only hold for the options they were made with; the first
+        // line names them.
+        const auto isResumed = !entries.empty() && entries.front().is_object() &&
+            entries.front().count("options") && entries.front().at("options") == options;
+        if (isResumed) {
+            for (auto& entry : entries) {
+                if (entry.count("unit"))
+                    _units[entry.at("unit").get<std::string>()] = std::move(entry);
+                else if (entry.count("writing"))
+                    _writes[entry.at("writing").get<std::string>()] = std::make_pair(
+                        entry.at("original").get<std::string>(), entry.at("rewritten").get<std::string>());
+            }
+        }
+        else if (!entries.empty()) {
+            llvm::errs() << "Discarding " << _filename << ", which a run with other options left.\n";
+        }
+
+        const auto flags = isResumed ? llvm::sys::fs::F_Append : llvm::sys::fs::F_None;
+        if (const auto error = llvm::sys::fs::openFileForWrite(_filename, _descriptor, flags))
+            throw Routines::ErrorCode{ "could not open " + _filename + ": " + error.message() };
+        _stream.reset(new llvm::raw_fd_ostream(_descriptor, /*shouldClose=*/true));
+        if (!isResumed)
+            _append({ {"options", options} });
+        // Keep a line cut off halfway apart from the next one.
+        else if (!endsWithNewline)
+            _write("\n");
+    }
+
+    Journal::~Journal() {
+        if (_stream)
+            _stream->clear_error();
+    }
+
+    bool Journal::replay(llvm::StringRef key,
+        DefinitionTable& headerDefinitions,
+        UnitRecords& records) const {
+        const auto found = _units.find(key);
+        if (found == _units.end())
+            return false;
+        const auto& entry = found->second;
+
+        // Read everything before touching the table, so malformed records
+        // leave no trace.
+        UnitRecords replayed;
+        std::vector<std::pair<Location, bool>> seenHeaderDefinitions;
+        try {
+            replayed.configuration = entry.at("configuration").get<std::string>();
+            for (const auto& expansion : entry.at("expansions")) {
+                const auto& call = expansion.at("call");
+                const auto& definition = expansion.at("definition");
+                UnitRecords::Expansion replayedExpansion{
+                    Query::IndividualMacroInfo(),
+                    replacementOf(expansion.at("edit"))
+                };
+                auto& macro = replayedExpansion.macro;
+                macro.call.emplace(Range(call.at("filename").get<std::string>(),
+                    offsetOf(call.at("begin")),
+                    offsetOf(call.at("end"))));
+                macro.definition.emplace(locationOf(definition.at("location")),
+                    definition.value("text", std::string()),
+                    definition.value("rewritten", std::string()),
+                    definition.at("macro").get<bool>());
+                macro.configuration = replayed.configuration;
+                replayed.expansions.push_back(std::move(replayedExpansion));
+            }
+            for (const auto& removal : entry.at("removals"))
+                replayed.removals.push_back(replacementOf(removal));
+            replayed.statistics = Statistics::fromJson(entry.at("statistics"));
+            for (const auto& definition : entry.at("headerDefinitions"))
+                seenHeaderDefinitions.emplace_back(locationOf(definition.at("location")), definition.at("used").get<bool>());
+            for (const auto& uses : entry.at("mainFileDefinitionUses"))
+                replayed.mainFileDefinitionUses.emplace_back(locationOf(uses.at("location")), uses.at("uses").get<size_t>());
+        }
+        catch (const std::exception&) {
+            return false;
+        }
+
+        for (auto& definition : seenHeaderDefinitions)
+            replayed.headerDefinitions.emplace_back(headerDefinitions.add(std::move(definition.first)), definition.second);
+        records = std::move(replayed);
+        return true;
+    }
+
+    void Journal::record(llvm::StringRef key,
+        const UnitRecords& records,
+        const DefinitionTable& headerDefinitions) {
+        nlohmann::json expansions = nlohmann::json::array();
+        for (const auto& expansion : records.expansions) {
+            // clang-format off
+            expansions.push_back({
+                {"call", expansion.macro.call->extent.toJson()},
+                {"definition", expansion.macro.definition->toJson()},
+                {"edit", toJson(expansion.replacement)}
+            });
+            // clang-format on
+        }
+        nlohmann::json removals = nlohmann::json::array();
+        for (const auto& removal : records.removals)
+            removals.push_back(toJson(removal));
+        nlohmann::json seenHeaderDefinitions = nlohmann::json::array();
+        for (const auto& definition : records.headerDefinitions) {
+            // clang-format off
+            seenHeaderDefinitions.push_back({
+                {"location", headerDefinitions.locationOf(definition.first).toJson()},
+                {"used", definition.second}
+            });
+            // clang-format on
+        }
+        nlohmann::json mainFileDefinitionUses = nlohmann::json::array();
+        for (const auto& uses : records.mainFileDefinitionUses) {
+            // clang-format off
+            mainFileDefinitionUses.push_back({
+                {"location", uses.first.toJson()},
+                {"uses", uses.second}
+            });
+            // clang-format on
+        }
+        // clang-format off
+        _append({
+            {"unit", key.str()},
+            {"configuration", records.configuration},
+            {"expansions", expansions},
+            {"removals", removals},
+            {"statistics", records.statistics.toJson()},
+            {"headerDefinitions", seenHeaderDefinitions},
+            {"mainFileDefinitionUses", mainFileDefinitionUses}
+        });
+        // clang-format on
+    }
+
+    bool Journal::isWritten(llvm::StringRef path, llvm::StringRef contents) const {
+        const auto found = _writes.find(path);
+        if (found == _writes.end())
+            return false;
+        const auto hash = md5Of(contents);
+        if (hash == found->second.second)
+            return true;
+        if (hash == found->second.first)
+            return false;
+        throw Routines::ErrorCode{ path.str() + " changed since the interrupted run; remove the journal to start afresh" };
+    }
+
+    void Journal::recordWriting(llvm::StringRef path, llvm::StringRef original, llvm::StringRef rewritten) {
+        // clang-format off
+        _append({
+            {"writing", path.str()},
+            {"original", md5Of(original)},
+            {"rewritten", md5Of(rewritten)}
+        });
+        // clang-format on
+    }
+
+    void Journal::remove() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_stream)
+            return;
+        _stream->clear_error();
+        _stream.reset();
+        _descriptor = -1;
+        llvm::sys::fs::remove(_filename);
+    }
+
+    void Journal::_append(const nlohmann::json& entry) {
+        const auto line = entry.dump() + '\n';
+        std::lock_guard<std::mutex> lock(_mutex);
+        _write(line);
+    }
+
+    void Journal::_write(llvm::StringRef text) {
+        *_stream << text;
+        _stream->flush();
+        if (_stream->has_error()) {
+            _stream->clear_error();
+            throw Routines::ErrorCode{ "could not write " + _filename };
+        }
+        if (!syncToDisk(_descriptor))
+            throw Routines::ErrorCode{ "could not write " + _filename + ": " + std::strerror(errno) };
+    }
+}  // namespace tidy
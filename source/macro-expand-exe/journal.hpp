@@ -0,0 +1,114 @@
+#ifndef MACRO_EXPAND_JOURNAL_HPP
+#define MACRO_EXPAND_JOURNAL_HPP
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// LLVM includes
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+
+// Standard includes
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace llvm {
+class raw_fd_ostream;
+}
+
+namespace tidy {
+    class DefinitionTable;
+    struct UnitRecords;
+
+    /// What a run finished so far, to resume it if it is interrupted.
+    ///
+    /// The journal is a file of JSON lines in its directory. Every translation
+    /// unit that preprocessed without errors appends its `UnitRecords`: its
+    /// expansions, edits, counters and which header definitions it saw and
+    /// used. Before a file is written, its path is appended with the MD5 of
+    /// its contents before and after. Each line is flushed to disk (`fsync`)
+    /// before the run goes on, so a killed run loses at most the translation
+    /// units in progress; a line cut off halfway is ignored.
+    ///
+    /// The first line records the options that shape the records and edits. A
+    /// run with other options discards the journal, with a warning, and starts
+    /// afresh. A run with the same command reads the journal back: translation
+    /// units it has are replayed instead of preprocessed. A file about to be
+    /// written is skipped if it already has the contents recorded as written,
+    /// and edited as usual if it still has the contents recorded before, so no
+    /// edit is made twice. Once the run completes, the journal is removed.
+    /// Locations are kept by path, so the run must be resumed in the same
+    /// checkout, and the sources must not change in between.
+    class Journal {
+    public:
+        /// Opens the journal in `directory`, creating it if needed, and reads
+        /// what an interrupted run with the same `options` recorded. Throws
+        /// `Routines::ErrorCode` if the journal cannot be written.
+        Journal(const std::string& directory, const nlohmann::json& options);
+
+        ~Journal();
+
+        Journal(const Journal&) = delete;
+        Journal& operator=(const Journal&) = delete;
+
+        /// Fills `records` with what the translation unit `key` found in an
+        /// interrupted run, adding the header definitions it saw to
+        /// `headerDefinitions`.
+        /// \returns false, leaving everything untouched, if the journal has no
+        /// usable records of `key`.
+        bool replay(llvm::StringRef key,
+            DefinitionTable& headerDefinitions,
+            UnitRecords& records) const;
+
+        /// Appends the `records` of the translation unit `key`, whose header
+        /// definitions have IDs in `headerDefinitions`.
+        void record(llvm::StringRef key,
+            const UnitRecords& records,
+            const DefinitionTable& headerDefinitions);
+
+        /// Returns true if an interrupted run already rewrote `path`, which
+        /// now has `contents`. Throws `Routines::ErrorCode` if the interrupted
+        /// run was about to write `path` and `contents` are neither what it
+        /// read nor what it wrote.
+        bool isWritten(llvm::StringRef path, llvm::StringRef contents) const;
+
+        /// Appends that `path`, which has `original` contents, is about to be
+        /// written with `rewritten` contents.
+        void recordWriting(llvm::StringRef path, llvm::StringRef original, llvm::StringRef rewritten);
+
+        /// Removes the journal, once the run it records is complete.
+        void remove();
+
+    private:
+        /// Appends `entry` as a line and flushes it to disk.
+        void _append(const nlohmann::json& entry);
+
+        /// Writes `text` and flushes it to disk. `_mutex` must be held, or
+        /// the journal not shared yet.
+        void _write(llvm::StringRef text);
+
+        /// The file of the journal.
+        std::string _filename;
+
+        /// The file descriptor of `_stream`, to flush it to disk.
+        int _descriptor = -1;
+
+        /// The journal appended to, or null once removed.
+        std::unique_ptr<llvm::raw_fd_ostream> _stream;
+
+        /// Serializes appends; translation units finish on several threads.
+        std::mutex _mutex;
+
+        /// The records of every translation unit an interrupted run finished,
+        /// by key.
+        llvm::StringMap<nlohmann::json> _units;
+
+        /// The MD5 of the contents before and after of every file an
+        /// interrupted run was about to write, by path.
+        llvm::StringMap<std::pair<std::string, std::string>> _writes;
+    };
+}  // namespace tidy
+
+#endif  // MACRO_EXPAND_JOURNAL_HPP
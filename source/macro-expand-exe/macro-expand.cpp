@@ -1,6 +1,8 @@
 // Project includes
 #include "misra-tidy/common/routines.hpp"
+#include "misra-tidy/common/unified-diff.hpp"
 #include "misra-tidy/macro-expand/options.hpp"
+#include "metrics.hpp"
 #include "result.hpp"
 #include "search.hpp"
 
@@ -12,12 +14,18 @@
 #include <clang/Tooling/CompilationDatabase.h>
 
 // LLVM includes
+#include <llvm/ADT/Optional.h>
 #include <llvm/ADT/StringRef.h>
 #include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/raw_ostream.h>
 
 // Standard includes
+#include <chrono>
+#include <memory>
 #include <string>
+#include <system_error>
 #include <vector>
 
 namespace {
@@ -51,30 +59,331 @@ source file gymnastics.
         llvm::cl::desc("Whether to generate the rewritten (expand) definition"),
         llvm::cl::cat(clangExpandCategory));
 
+    llvm::cl::opt<std::string> statsOption(
+        "stats",
+        llvm::cl::ValueOptional,
+        llvm::cl::value_desc("file"),
+        llvm::cl::desc("Print run statistics as one line of JSON to stderr, or append them to <file>"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::opt<std::string> metricsFileOption(
+        "metrics-file",
+        llvm::cl::value_desc("file.prom"),
+        llvm::cl::desc("Write run metrics in Prometheus text format to <file.prom>, periodically and at exit"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::opt<unsigned> metricsIntervalOption(
+        "metrics-interval",
+        llvm::cl::init(15),
+        llvm::cl::value_desc("seconds"),
+        llvm::cl::desc("How often to update the -metrics-file during the run"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::opt<std::string> tokenCacheOption(
+        "token-cache",
+        llvm::cl::value_desc("directory"),
+        llvm::cl::desc("Cache the tokens of each translation unit in <directory> and reuse them while its files are unchanged"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::opt<std::string> includeCacheOption(
+        "include-cache",
+        llvm::cl::value_desc("file"),
+        llvm::cl::desc("Remember failed include lookups in <file> and skip them in later runs while their directories are unchanged"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::opt<bool> prescanOption(
+        "prescan",
+        llvm::cl::init(true),
+        llvm::cl::desc("Whether to skip translation units that cannot reach a macro definition (with -remUnused=false: a macro use) outside system headers"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::list<std::string> includePathOption(
+        "include-path",
+        llvm::cl::CommaSeparated,
+        llvm::cl::value_desc("glob"),
+        llvm::cl::desc("Only expand and remove macros in files whose absolute path matches one of these globs"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::list<std::string> excludePathOption(
+        "exclude-path",
+        llvm::cl::CommaSeparated,
+        llvm::cl::value_desc("glob"),
+        llvm::cl::desc("Never expand or remove macros in files whose absolute path matches one of these globs, e.g. '*/third_party/*'"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::list<std::string> macrosOption(
+        "macros",
+        llvm::cl::CommaSeparated,
+        llvm::cl::value_desc("regex"),
+        llvm::cl::desc("Only expand and remove macros whose name fully matches one of these regular expressions"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::list<std::string> skipMacrosOption(
+        "skip-macros",
+        llvm::cl::CommaSeparated,
+        llvm::cl::value_desc("regex"),
+        llvm::cl::desc("Never expand or remove macros whose name fully matches one of these regular expressions"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::opt<std::string> sinceOption(
+        "since",
+        llvm::cl::value_desc("revision"),
+        llvm::cl::desc("Only preprocess translation units that read a file changed in the git work tree since <revision>"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::opt<std::string> includeGraphOption(
+        "include-graph",
+        llvm::cl::value_desc("file"),
+        llvm::cl::desc("Record the files each translation unit reads in <file>, for -since (default: macro-expand-include-graph.json in the git directory)"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::opt<bool> changedLinesOnlyOption(
+        "changed-lines-only",
+        llvm::cl::init(false),
+        llvm::cl::desc("With -since, only expand macros on lines changed since the revision"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::opt<bool> watchOption(
+        "watch",
+        llvm::cl::init(false),
+        llvm::cl::desc("Keep running and print the findings of the translation units affected by each change to their files, as one line of JSON per change. Never writes files"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::opt<std::string> exportFixesOption(
+        "export-fixes",
+        llvm::cl::value_desc("file"),
+        llvm::cl::desc("Write every edit to <file> as clang-apply-replacements YAML instead of applying it"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::opt<std::string> shardOption(
+        "shard",
+        llvm::cl::value_desc("i/N"),
+        llvm::cl::desc("Only run on shard i (from 0) of N of the sources and print output for 'macro-expand merge'"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::opt<bool> shardBySizeOption(
+        "shard-by-size",
+        llvm::cl::init(false),
+        llvm::cl::desc("Balance -shard by source size instead of splitting by a hash of the paths"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::opt<std::string> stdinFileOption(
+        "stdin-file",
+        llvm::cl::value_desc("file"),
+        llvm::cl::desc("Read the unsaved contents of <file> from stdin and print its rewritten contents to stdout instead of writing any file"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::opt<unsigned> jobsOption(
+        "j",
+        llvm::cl::init(0),
+        llvm::cl::value_desc("threads"),
+        llvm::cl::desc("Preprocess translation units and apply edits with this many threads (default: one per core)"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::opt<std::string> timingHistoryOption(
+        "timing-history",
+        llvm::cl::value_desc("file"),
+        llvm::cl::desc("Remember how long each translation unit took in <file> and start the slowest first in later runs"),
+        llvm::cl::cat(clangExpandCategory));
+
+    llvm::cl::opt<std::string> journalOption(
+        "journal",
+        llvm::cl::value_desc("dir"),
+        llvm::cl::desc("Journal finished translation units and written files in <dir>, and resume from it after an interruption"),
+        llvm::cl::cat(clangExpandCategory));
+
+    /// Where rewritten files go.
+    enum class OutputMode { kFiles, kDiff };
+
+    llvm::cl::opt<OutputMode> outputOption(
+        "output",
+        llvm::cl::init(OutputMode::kFiles),
+        llvm::cl::desc("Where to put rewritten files:"),
+        llvm::cl::values(
+            clEnumValN(OutputMode::kFiles, "files", "Overwrite the files in place"),
+            clEnumValN(OutputMode::kDiff, "diff", "Print a unified diff of all changes to stdout and write nothing")),
+        llvm::cl::cat(clangExpandCategory));
+
     llvm::cl::extrahelp
         commonHelp(clang::tooling::CommonOptionsParser::HelpMessage);
+
+    /// Prints the statistics of a run as requested by `-stats`.
+    void printStatistics(const tidy::Statistics& statistics) {
+        const auto line = statistics.toJson().dump();
+        if (statsOption.empty()) {
+            llvm::errs() << line << '\n';
+            return;
+        }
+        std::error_code error;
+        llvm::raw_fd_ostream stream(statsOption, error, llvm::sys::fs::F_Append | llvm::sys::fs::F_Text);
+        if (error) {
+            llvm::errs() << "Could not open " << statsOption << ": " << error.message() << '\n';
+            return;
+        }
+        stream << line << '\n';
+    }
+
+    /// Prints every file the run rewrote in memory as a unified diff against
+    /// its original contents, with paths relative to the working directory.
+    void printDiff(const tidy::Result& result, const tidy::Options& options) {
+        const auto stdinFile = options.stdinFile.empty() ? std::string() : tidy::Routines::makeAbsolute(options.stdinFile);
+        for (const auto& file : result._writtenFiles) {
+            std::unique_ptr<llvm::MemoryBuffer> original;
+            if (file.first == stdinFile) {
+                original = llvm::MemoryBuffer::getMemBuffer(options.stdinContents);
+            }
+            else if (auto buffer = llvm::MemoryBuffer::getFile(file.first)) {
+                original = std::move(*buffer);
+            }
+            else {
+                llvm::errs() << "Could not read " << file.first << '\n';
+                continue;
+            }
+            tidy::writeUnifiedDiff(llvm::outs(), tidy::Routines::makeRelative(file.first), original->getBuffer(), file.second);
+        }
+    }
+
+    /// Prints the rewritten contents of the `-stdin-file` (as read if nothing
+    /// changed) and names any other file the run would have written.
+    void printStdinFile(const tidy::Result& result, const tidy::Options& options) {
+        const auto path = tidy::Routines::makeAbsolute(options.stdinFile);
+        const auto written = result._writtenFiles.find(path);
+        llvm::outs() << (written == result._writtenFiles.end() ? options.stdinContents : written->second);
+        for (const auto& file : result._writtenFiles) {
+            if (file.first != path)
+                llvm::errs() << "Not writing " << file.first << ", which would change too.\n";
+        }
+    }
+
+    /// Sets the shard of `options` from `-shard=i/N`.
+    void parseShard(tidy::Options& options) {
+        const auto parts = llvm::StringRef(shardOption).split('/');
+        if (parts.first.getAsInteger(10, options.shardIndex) ||
+            parts.second.getAsInteger(10, options.shardCount) ||
+            options.shardCount == 0 || options.shardIndex >= options.shardCount)
+            throw tidy::Routines::ErrorCode{ "-shard must be i/N with 0 <= i < N" };
+        options.wantsShardsBySize = shardBySizeOption;
+    }
+
+    /// Runs `macro-expand merge <shard output>...`.
+    int mergeShards(int argc, const char* argv[]) {
+        llvm::cl::list<std::string> shardFiles(
+            llvm::cl::Positional,
+            llvm::cl::OneOrMore,
+            llvm::cl::desc("<output of each -shard run>"));
+        llvm::cl::ParseCommandLineOptions(argc, argv,
+            "Merges the outputs of all -shard runs and removes the header macros no shard used\n");
+
+        try {
+            tidy::Search::SourceVector noSources;
+            tidy::Search search(noSources);
+            tidy::Options options{
+                fcnCallExpansionOption,
+                objectExpansionOption,
+                removeUnusedMacrosOption,
+                rewriteOption
+            };
+            options.jobs = jobsOption;
+            llvm::outs() << search.merge(shardFiles, options).dump(2) << '\n';
+        }
+        catch (tidy::Routines::ErrorCode& er) {
+            llvm::outs() << er.message;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
 }  // namespace
 
 auto main(int argc, const char* argv[]) -> int {
     using namespace clang::tooling;  // NOLINT(build/namespaces)
 
+    if (argc > 1 && llvm::StringRef(argv[1]) == "merge")
+        return mergeShards(argc - 1, argv + 1);
+
     CommonOptionsParser options(argc, argv, clangExpandCategory);
     auto sources = options.getSourcePathList();
     auto& db = options.getCompilations();
 
+    llvm::Optional<tidy::MetricsWriter> metrics;
+    if (!metricsFileOption.empty())
+        metrics.emplace(metricsFileOption, std::chrono::seconds(metricsIntervalOption));
+
     try {
         // clang-format off
         tidy::Search search(sources);
-        auto result = search.run(db, {
+        if (metrics) {
+            search.onProgress([&metrics](const tidy::Statistics& statistics) {
+                metrics->update(statistics);
+            });
+        }
+        tidy::Options queryOptions{
             fcnCallExpansionOption,
             objectExpansionOption,
             removeUnusedMacrosOption,
-            rewriteOption
-        });
+            rewriteOption,
+            tokenCacheOption,
+            includeCacheOption,
+            prescanOption,
+            includePathOption,
+            excludePathOption,
+            macrosOption,
+            skipMacrosOption,
+            sinceOption,
+            includeGraphOption,
+            changedLinesOnlyOption
+        };
         // clang-format on
-        llvm::outs() << result.toJson().dump(2) << '\n';
+        if (outputOption == OutputMode::kDiff)
+            queryOptions.wantsFilesWritten = false;
+        queryOptions.exportFixesFile = exportFixesOption;
+        queryOptions.jobs = jobsOption;
+        queryOptions.timingHistoryFile = timingHistoryOption;
+        queryOptions.journalDirectory = journalOption;
+        if (!shardOption.empty())
+            parseShard(queryOptions);
+        if (!stdinFileOption.empty()) {
+            auto input = llvm::MemoryBuffer::getSTDIN();
+            if (!input)
+                throw tidy::Routines::ErrorCode{ "could not read stdin" };
+            queryOptions.wantsFilesWritten = false;
+            queryOptions.stdinFile = stdinFileOption;
+            queryOptions.stdinContents = (*input)->getBuffer().str();
+        }
+        if (watchOption) {
+            search.watch(db, queryOptions, [](const std::vector<std::string>& changed,
+                                               const std::vector<std::string>& translationUnits,
+                                               const tidy::Result& result,
+                                               bool succeeded) {
+                // clang-format off
+                const nlohmann::json update = {
+                    {"changed", changed},
+                    {"translationUnits", translationUnits},
+                    {"succeeded", succeeded},
+                    {"macros", result.toJson()}
+                };
+                // clang-format on
+                llvm::outs() << update.dump() << '\n';
+                llvm::outs().flush();
+            });
+            return EXIT_SUCCESS;  // Not reached: watching ends with the process.
+        }
+        auto result = search.run(db, queryOptions);
+        if (queryOptions.shardCount > 1)
+            llvm::outs() << result.toShardJson().dump() << '\n';
+        else if (outputOption == OutputMode::kDiff)
+            printDiff(result, queryOptions);
+        else if (!stdinFileOption.empty() && queryOptions.wantsRewritten)
+            printStdinFile(result, queryOptions);
+        else
+            llvm::outs() << result.toJson().dump(2) << '\n';
+        if (statsOption.getNumOccurrences() > 0)
+            printStatistics(result._statistics);
+        if (metrics)
+            metrics->finish(result._statistics, /*succeeded=*/true);
     }
     catch (tidy::Routines::ErrorCode &er) {
+        if (metrics)
+            metrics->finish(/*succeeded=*/false);
         llvm::outs() << er.message;
         exit(EXIT_FAILURE);
     }
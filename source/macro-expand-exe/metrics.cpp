@@ -0,0 +1,112 @@
+// Project includes
+#include "misra-tidy/common/routines.hpp"
+#include "metrics.hpp"
+
+// LLVM includes
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Standard includes
+#include <chrono>
+#include <ctime>
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace tidy {
+    namespace {
+        /// Writes the `# HELP` and `# TYPE` header of a metric family.
+        void family(llvm::raw_ostream& out,
+            llvm::StringRef name,
+            llvm::StringRef type,
+            llvm::StringRef help) {
+            out << "# HELP " << name << ' ' << help << '\n';
+            out << "# TYPE " << name << ' ' << type << '\n';
+        }
+
+        /// Writes a metric family with a single, unlabeled sample.
+        template <typename Value>
+        void sample(llvm::raw_ostream& out,
+            llvm::StringRef name,
+            llvm::StringRef type,
+            llvm::StringRef help,
+            Value value) {
+            family(out, name, type, help);
+            out << name << ' ' << value << '\n';
+        }
+    }  // namespace
+
+    MetricsWriter::MetricsWriter(std::string filename, std::chrono::seconds interval)
+        : _filename(std::move(filename))
+        , _interval(interval)
+        , _lastWrite(std::chrono::steady_clock::now()) {
+    }
+
+    void MetricsWriter::update(const Statistics& statistics) {
+        _last = statistics;
+        const auto now = std::chrono::steady_clock::now();
+        if (now - _lastWrite < _interval)
+            return;
+        _lastWrite = now;
+        _write(/*finished=*/false, /*succeeded=*/false);
+    }
+
+    void MetricsWriter::finish(const Statistics& statistics, bool succeeded) {
+        _last = statistics;
+        finish(succeeded);
+    }
+
+    void MetricsWriter::finish(bool succeeded) {
+        _write(/*finished=*/true, succeeded);
+    }
+
+    void MetricsWriter::_write(bool finished, bool succeeded) {
+        const auto temporary = _filename + ".tmp";
+        {
+            std::error_code error;
+            llvm::raw_fd_ostream out(temporary, error, llvm::sys::fs::F_Text);
+            if (error) {
+                llvm::errs() << "Could not write metrics to " << temporary << ": "
+                             << error.message() << '\n';
+                return;
+            }
+
+            sample(out, "macro_expand_translation_units_total", "counter",
+                "Translation units processed.", _last.translationUnits);
+            sample(out, "macro_expand_translation_units_failed_total", "counter",
+                "Translation units that had compile errors.", _last.failedTranslationUnits);
+            sample(out, "macro_expand_expansions_total", "counter",
+                "Macro expansions recorded.", _last.expansions);
+            sample(out, "macro_expand_definitions_removed_total", "counter",
+                "Unused macro definitions removed.", _last.definitionsRemoved);
+            sample(out, "macro_expand_written_bytes_total", "counter",
+                "Bytes written to rewritten files.", _last.bytesWritten);
+
+            family(out, "macro_expand_phase_duration_seconds", "gauge",
+                "Wall-clock time spent in each phase, including those still in progress.");
+            for (const auto& phase : _last.phaseSecondsSoFar()) {
+                out << "macro_expand_phase_duration_seconds{phase=\"" << phase.first
+                    << "\"} " << phase.second << '\n';
+            }
+
+            sample(out, "macro_expand_peak_resident_bytes", "gauge",
+                "Peak resident set size of the process.", Routines::peakResidentBytes());
+            sample(out, "macro_expand_run_finished", "gauge",
+                "Whether the run has finished.", finished ? 1 : 0);
+            if (finished) {
+                sample(out, "macro_expand_run_succeeded", "gauge",
+                    "Whether the run finished without a fatal error.", succeeded ? 1 : 0);
+            }
+            sample(out, "macro_expand_last_update_timestamp_seconds", "gauge",
+                "Unix time of the last update of this file.",
+                static_cast<long long>(std::time(nullptr)));
+        }
+
+        if (const auto error = llvm::sys::fs::rename(temporary, _filename)) {
+            llvm::errs() << "Could not write metrics to " << _filename << ": "
+                         << error.message() << '\n';
+        }
+    }
+
+}  // namespace tidy
@@ -0,0 +1,46 @@
+#ifndef MACRO_EXPAND_METRICS_HPP
+#define MACRO_EXPAND_METRICS_HPP
+
+// Project includes
+#include "misra-tidy/macro-expand/statistics.hpp"
+
+// Standard includes
+#include <chrono>
+#include <string>
+
+namespace tidy {
+    /// Writes the `Statistics` of a run to a file in the Prometheus text
+    /// exposition format, for the textfile collector of node-exporter.
+    ///
+    /// The file is replaced atomically (written next to the target and renamed),
+    /// so a scrape never sees a partially written file.
+    class MetricsWriter {
+    public:
+        /// Constructs a writer for `filename` that writes at most every `interval`
+        /// while the run is in progress.
+        MetricsWriter(std::string filename, std::chrono::seconds interval);
+
+        /// Records the statistics of the ongoing run and writes them out if the
+        /// last write is at least `interval` ago.
+        void update(const Statistics& statistics);
+
+        /// Writes the final statistics of the run. `succeeded` is false if the run
+        /// was aborted, in which case the last statistics passed to `update` are
+        /// written.
+        void finish(const Statistics& statistics, bool succeeded);
+        void finish(bool succeeded);
+
+    private:
+        /// Renders `_last` and replaces the metrics file with it.
+        void _write(bool finished, bool succeeded);
+
+        std::string _filename;
+        std::chrono::seconds _interval;
+        std::chrono::steady_clock::time_point _lastWrite;
+
+        /// The most recent statistics we have seen.
+        Statistics _last;
+    };
+}  // namespace tidy
+
+#endif  // MACRO_EXPAND_METRICS_HPP
@@ -8,6 +8,9 @@
 // Third party includes
 #include <third-party/json.hpp>
 
+// Clang includes
+#include <clang/Tooling/Core/Replacement.h>
+
 // LLVM includes
 #include <llvm/ADT/Optional.h>
 
@@ -19,7 +22,17 @@ namespace tidy {
     Result::Result(Query&& query)
         :_macros{ std::move(query._macroInvocations) }
         ,_needsJson(!query.options.wantsRewritten)
+        ,_writtenFiles{ std::move(query._writtenFiles) }
+        ,_shardIndex(query.options.shardIndex)
+        ,_shardCount(query.options.shardCount)
+        ,_statistics(query.statistics)
     {
+        if (_shardCount > 1) {
+            _edits = std::move(query._replacements);
+            const auto& definitions = query._headerDefinitions;
+            for (unsigned id = 0; id < definitions.size(); ++id)
+                _headerDefinitionUses.emplace_back(definitions.locationOf(id), definitions.isUsed(id) ? 1 : 0);
+        }
     }
 
     nlohmann::json Result::toJson() const {
@@ -34,10 +47,48 @@ namespace tidy {
                 if (macroInfo.definition.hasValue()) {
                     macroJson["definition"] = macroInfo.definition->toJson();
                 }
+
+                if (!macroInfo.configuration.empty()) {
+                    macroJson["configuration"] = macroInfo.configuration;
+                }
                 json.push_back(macroJson);
             }
         }
         return json.is_null() ? "" : json;
     }
 
+    nlohmann::json Result::toShardJson() const {
+        auto macros = toJson();
+        nlohmann::json edits = nlohmann::json::array();
+        for (const auto& edit : _edits) {
+            // clang-format off
+            edits.push_back({
+                {"file", Routines::makeRelative(edit.getFilePath().str())},
+                {"offset", edit.getOffset()},
+                {"length", edit.getLength()},
+                {"text", edit.getReplacementText().str()}
+            });
+            // clang-format on
+        }
+        nlohmann::json headerDefinitions = nlohmann::json::array();
+        for (const auto& definition : _headerDefinitionUses) {
+            auto location = definition.first;
+            location.filename = Routines::makeRelative(Routines::makeAbsolute(location.filename));
+            // clang-format off
+            headerDefinitions.push_back({
+                {"location", location.toJson()},
+                {"uses", definition.second}
+            });
+            // clang-format on
+        }
+        // clang-format off
+        return {
+            {"shard", {{"index", _shardIndex}, {"count", _shardCount}}},
+            {"macros", macros.is_array() ? macros : nlohmann::json::array()},
+            {"edits", edits},
+            {"headerDefinitions", headerDefinitions}
+        };
+        // clang-format on
+    }
+
 }  // namespace tidy
@@ -4,15 +4,26 @@
 
 // Project includes
 #include "misra-tidy/common/definition-data.hpp"
+#include "misra-tidy/common/location.hpp"
 #include "misra-tidy/common/range.hpp"
 #include "misra-tidy/macro-expand/query.hpp"
 
+// Clang includes
+#include <clang/Tooling/Core/Replacement.h>
+
 // LLVM includes
 #include <llvm/ADT/Optional.h>
 
 // Third party includes
 #include <third-party/json.hpp>
 
+// Standard includes
+#include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
 namespace llvm {
 class raw_ostream;
 }
@@ -33,8 +44,33 @@ struct Result {
   /// Converts the `Result` to JSON.
   nlohmann::json toJson() const;
 
+  /// Converts the `Result` of a sharded run to the JSON `macro-expand merge`
+  /// reads: the shard, its macro records, its edits and whether it used every
+  /// header definition it saw. Paths are relative to the working directory,
+  /// so the merge may run in another checkout.
+  nlohmann::json toShardJson() const;
+
   std::vector<Query::IndividualMacroInfo> _macros;
   bool _needsJson;
+
+  /// The new contents of the files rewritten in memory, by absolute path, if
+  /// files were not written to disk.
+  std::map<std::string, std::string> _writtenFiles;
+
+  /// The shard the run covered, and out of how many.
+  unsigned _shardIndex;
+  unsigned _shardCount;
+
+  /// The edits of a sharded run, which leaves them to the merge to apply
+  /// together with the removals from headers.
+  std::vector<clang::tooling::Replacement> _edits;
+
+  /// The uses of each header definition, for sharded runs, whose headers are
+  /// only cleaned up once all shards are merged.
+  std::vector<std::pair<Location, std::size_t>> _headerDefinitionUses;
+
+  /// Counters and phase timings of the run that produced this result.
+  Statistics _statistics;
 };
 }  // namespace tidy
 
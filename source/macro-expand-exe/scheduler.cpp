@@ -0,0 +1,103 @@
+// Project includes
+#include "scheduler.hpp"
+
+// Standard includes
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace tidy {
+    namespace {
+        /// The tasks waiting for a thread.
+        struct Queue {
+            std::mutex mutex;
+            std::deque<std::size_t> tasks;
+        };
+    }  // namespace
+
+    Scheduler::Scheduler(unsigned jobs)
+        : _jobs(std::max(jobs, 1u)) {
+    }
+
+    void Scheduler::run(const std::vector<double>& costs, const Work& work) const {
+        const auto threadCount = std::min<std::size_t>(_jobs, costs.size());
+        if (threadCount == 0)
+            return;
+
+        std::vector<std::size_t> order(costs.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&costs](std::size_t first, std::size_t second) {
+            return costs[first] > costs[second];
+        });
+        std::vector<Queue> queues(threadCount);
+        for (std::size_t index = 0; index < order.size(); ++index)
+            queues[index % threadCount].tasks.push_back(order[index]);
+
+        // Takes the next task of queue `self`, or steals the longest one at the
+        // front of another queue. Tasks are never added, so once every queue is
+        // empty, the run is over.
+        const auto take = [&](std::size_t self, std::size_t& task) {
+            {
+                std::lock_guard<std::mutex> lock(queues[self].mutex);
+                if (!queues[self].tasks.empty()) {
+                    task = queues[self].tasks.front();
+                    queues[self].tasks.pop_front();
+                    return true;
+                }
+            }
+            for (;;) {
+                std::size_t victim = threadCount;
+                double longest = 0;
+                for (std::size_t other = 0; other < threadCount; ++other) {
+                    std::lock_guard<std::mutex> lock(queues[other].mutex);
+                    if (!queues[other].tasks.empty() &&
+                        (victim == threadCount || costs[queues[other].tasks.front()] > longest)) {
+                        victim = other;
+                        longest = costs[queues[other].tasks.front()];
+                    }
+                }
+                if (victim == threadCount)
+                    return false;
+                std::lock_guard<std::mutex> lock(queues[victim].mutex);
+                if (!queues[victim].tasks.empty()) {
+                    task = queues[victim].tasks.front();
+                    queues[victim].tasks.pop_front();
+                    return true;
+                }
+            }
+        };
+
+        std::atomic<bool> stopped(false);
+        std::mutex errorMutex;
+        std::exception_ptr error;
+        const auto worker = [&](std::size_t self) {
+            std::size_t task;
+            while (!stopped && take(self, task)) {
+                try {
+                    work(task);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error)
+                        error = std::current_exception();
+                    stopped = true;
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (std::size_t thread = 1; thread < threadCount; ++thread)
+            threads.emplace_back(worker, thread);
+        worker(0);
+        for (auto& thread : threads)
+            thread.join();
+        if (error)
+            std::rethrow_exception(error);
+    }
+}  // namespace tidy
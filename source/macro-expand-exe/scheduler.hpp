@@ -0,0 +1,38 @@
+#ifndef MACRO_EXPAND_SCHEDULER_HPP
+#define MACRO_EXPAND_SCHEDULER_HPP
+
+// Standard includes
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace tidy {
+    /// Runs tasks on a pool of threads, longest predicted first.
+    ///
+    /// The tasks are sorted by predicted cost and dealt round-robin to one
+    /// queue per thread, so every queue starts with its share of the longest
+    /// tasks. Each thread works through its own queue from the front. Once it
+    /// is empty, the thread steals the longest task at the front of any other
+    /// queue. The few giant tasks of a run thus start first instead of last,
+    /// and no thread idles while another still has tasks waiting.
+    class Scheduler {
+    public:
+        /// Works on the task of the given index.
+        using Work = std::function<void(std::size_t)>;
+
+        /// Creates a scheduler running up to `jobs` tasks at a time.
+        explicit Scheduler(unsigned jobs);
+
+        /// Calls `work` with the index of every task in `costs`, from up to
+        /// `jobs` threads (the calling one included). Once all threads are
+        /// done, rethrows the first exception a call threw; no task is started
+        /// after it.
+        void run(const std::vector<double>& costs, const Work& work) const;
+
+    private:
+        /// The number of tasks run at a time.
+        unsigned _jobs;
+    };
+}  // namespace tidy
+
+#endif  // MACRO_EXPAND_SCHEDULER_HPP
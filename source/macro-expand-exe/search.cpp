@@ -1,85 +1,923 @@
 // Project includes
+#include "misra-tidy/common/probes.hpp"
 #include "misra-tidy/common/routines.hpp"
 #include "misra-tidy/macro-expand/action-factory.hpp"
+#include "misra-tidy/macro-expand/changes.hpp"
+#include "misra-tidy/macro-expand/include-graph.hpp"
+#include "misra-tidy/macro-expand/prescan.hpp"
 #include "misra-tidy/macro-expand/query.hpp"
+#include "file-watcher.hpp"
+#include "file-writer.hpp"
+#include "journal.hpp"
 #include "result.hpp"
+#include "scheduler.hpp"
 #include "search.hpp"
+#include "timing-history.hpp"
 
 // Clang includes
+#include <clang/Basic/DiagnosticOptions.h>
+#include <clang/Basic/FileManager.h>
+#include <clang/Basic/FileSystemOptions.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/CompilerInvocation.h>
+#include <clang/Frontend/DependencyOutputOptions.h>
+#include <clang/Frontend/PCHContainerOperations.h>
+#include <clang/Frontend/Utils.h>
+#include <clang/Tooling/ArgumentsAdjusters.h>
+#include <clang/Tooling/CompilationDatabase.h>
+#include <clang/Tooling/Core/Replacement.h>
+#include <clang/Tooling/ReplacementsYaml.h>
 #include <clang/Tooling/Tooling.h>
 
 // LLVM includes
 #include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/IntrusiveRefCntPtr.h>
 #include <llvm/ADT/Optional.h>
+#include <llvm/ADT/SmallString.h>
 #include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/YAMLTraits.h>
+#include <llvm/Support/raw_ostream.h>
 
 // Standard includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <system_error>
+#include <thread>
 #include <type_traits>
-#include <fstream>
+#include <utility>
+#include <iterator>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace tidy {
+    namespace {
+        /// Returns the path of this executable, which clang uses to find its
+        /// builtin headers (just like `clang::tooling::ClangTool`).
+        std::string mainExecutable() {
+            static int staticSymbol;
+            return llvm::sys::fs::getMainExecutable("macro-expand", &staticSymbol);
+        }
+
+        /// Returns the `-D` and `-U` arguments of `commandLine`, which tell the
+        /// configurations of a file apart.
+        std::string macroArguments(const std::vector<std::string>& commandLine) {
+            std::string configuration;
+            for (auto it = commandLine.begin(); it != commandLine.end(); ++it) {
+                const llvm::StringRef argument(*it);
+                if (!argument.startswith("-D") && !argument.startswith("-U"))
+                    continue;
+                if (!configuration.empty())
+                    configuration += ' ';
+                configuration += argument;
+                if (argument.size() == 2 && std::next(it) != commandLine.end())
+                    configuration += *++it;
+            }
+            return configuration;
+        }
+
+        /// Returns the 64-bit FNV-1a hash of `text`, which unlike `std::hash` and
+        /// `llvm::hash_value` is the same on every machine and in every build.
+        std::uint64_t stableHash(llvm::StringRef text) {
+            std::uint64_t hash = 14695981039346656037ULL;
+            for (const char character : text) {
+                hash ^= static_cast<unsigned char>(character);
+                hash *= 1099511628211ULL;
+            }
+            return hash;
+        }
+
+        /// Writes `replacements`, without duplicates, to `filename` in the YAML
+        /// format of clang-apply-replacements.
+        void exportFixes(const std::string& filename,
+            std::vector<clang::tooling::Replacement> replacements) {
+            std::sort(replacements.begin(), replacements.end());
+            replacements.erase(std::unique(replacements.begin(), replacements.end()), replacements.end());
+            clang::tooling::TranslationUnitReplacements fixes;
+            fixes.Replacements = std::move(replacements);
+
+            std::error_code error;
+            llvm::raw_fd_ostream stream(filename, error, llvm::sys::fs::F_Text);
+            if (error)
+                throw Routines::ErrorCode{ "could not write " + filename + ": " + error.message() };
+            llvm::yaml::Output yaml(stream);
+            yaml << fixes;
+        }
+
+        /// Returns the options that shape what a journal records: which macros
+        /// are expanded and removed where, and what becomes of the edits. Caches,
+        /// threads and other options that only change how fast a run is are
+        /// left out, so a run resumed with them changed keeps its journal.
+        nlohmann::json journalOptionsOf(const Options& options) {
+            // clang-format off
+            return {
+                {"fcnCallExpand", options.wantsFcnCallExpand},
+                {"objectExpand", options.wantsObjectExpand},
+                {"unusedRemoved", options.wantsUnusedRemoved},
+                {"rewritten", options.wantsRewritten},
+                {"includePaths", options.includePaths},
+                {"excludePaths", options.excludePaths},
+                {"macros", options.macros},
+                {"skippedMacros", options.skippedMacros},
+                {"since", options.since},
+                {"changedLinesOnly", options.wantsChangedLinesOnly},
+                {"filesWritten", options.wantsFilesWritten},
+                {"exportFixes", options.exportFixesFile},
+                {"shard", {{"index", options.shardIndex}, {"count", options.shardCount}, {"bySize", options.wantsShardsBySize}}},
+                {"stdinFile", options.stdinFile}
+            };
+            // clang-format on
+        }
+
+        /// Returns the number of threads `options` ask for.
+        unsigned jobsOf(const Options& options) {
+            if (options.jobs > 0)
+                return options.jobs;
+            return std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        /// How many bytes of rewritten files may wait for the writer thread
+        /// before rewriting more blocks.
+        constexpr std::size_t kWriteBufferBytes = 64 * 1024 * 1024;
+
+        /// How much an include adds to the weight of a translation unit without
+        /// timing history: about as much as 16 KiB of main file, a typical
+        /// header with the few it includes in turn.
+        constexpr double kIncludeWeight = 16 * 1024;
+
+        /// Returns the weight of the translation unit of `mainFile`, to predict
+        /// its cost without timing history: the size of the main file plus
+        /// `kIncludeWeight` for each of its include directives.
+        double weightOf(FileCache& fileCache, const std::string& mainFile) {
+            const auto contents = fileCache.contents(mainFile);
+            if (!contents)
+                return 0;
+            const auto text = (*contents)->getBuffer();
+            const char* const end = text.end();
+            std::size_t includes = 0;
+            for (const char* it = text.begin();
+                 (it = static_cast<const char*>(std::memchr(it, '#', end - it))) != nullptr;) {
+                ++it;
+                while (it != end && (*it == ' ' || *it == '\t'))
+                    ++it;
+                const llvm::StringRef directive(it, end - it);
+                if (directive.startswith("include") || directive.startswith("import"))
+                    ++includes;
+            }
+            return text.size() + includes * kIncludeWeight;
+        }
+
+        /// Makes the paths of `invocation` that are relative to the directory of
+        /// its compile command absolute, so it can run from any directory, and
+        /// drops the outputs it would write besides preprocessing.
+        void makePathsAbsolute(clang::CompilerInvocation& invocation, const std::string& directory) {
+            auto base = invocation.getFileSystemOpts().WorkingDir;
+            if (base.empty())
+                base = directory;
+            const auto absolute = [&base](std::string& path) {
+                if (path.empty() || llvm::sys::path::is_absolute(path))
+                    return false;
+                llvm::SmallString<256> result(base);
+                llvm::sys::path::append(result, path);
+                path = result.str();
+                return true;
+            };
+
+            auto& headerSearch = invocation.getHeaderSearchOpts();
+            // clang only prefixes absolute directories with the sysroot.
+            for (auto& entry : headerSearch.UserEntries) {
+                if (absolute(entry.Path))
+                    entry.IgnoreSysRoot = true;
+            }
+            absolute(headerSearch.Sysroot);
+            absolute(headerSearch.ResourceDir);
+            for (auto& file : headerSearch.VFSOverlayFiles)
+                absolute(file);
+
+            auto& preprocessor = invocation.getPreprocessorOpts();
+            for (auto& file : preprocessor.Includes)
+                absolute(file);
+            for (auto& file : preprocessor.MacroIncludes)
+                absolute(file);
+            absolute(preprocessor.ImplicitPCHInclude);
+            absolute(preprocessor.ImplicitPTHInclude);
+
+            // Dependency files (`-MD -MF`), header include lists (`-H`) and
+            // include graphs (`-dependency-dot`) are no use to macro-expand, and
+            // their relative paths would be opened from the wrong directory.
+            invocation.getDependencyOutputOpts() = clang::DependencyOutputOptions();
+        }
+
+        /// Returns a copy of `invocation` preprocessing the absolute `filename`
+        /// instead of the input of the command it was created from.
+        std::shared_ptr<clang::CompilerInvocation> invocationFor(
+            const clang::CompilerInvocation& invocation,
+            const std::string& filename) {
+            const auto kind = invocation.getFrontendOpts().Inputs.front().getKind();
+            auto unitInvocation = std::make_shared<clang::CompilerInvocation>(invocation);
+            unitInvocation->getFrontendOpts().Inputs.clear();
+            unitInvocation->getFrontendOpts().Inputs.emplace_back(filename, kind);
+            if (!unitInvocation->getCodeGenOpts().MainFileName.empty())
+                unitInvocation->getCodeGenOpts().MainFileName = llvm::sys::path::filename(filename);
+            return unitInvocation;
+        }
+
+        /// Sets up the filters and caches `query.options` ask for, which live as
+        /// long as the query.
+        void configure(Query& query) {
+            const auto& options = query.options;
+            if (!options.includePaths.empty() || !options.excludePaths.empty())
+                query._pathFilter.emplace(options.includePaths, options.excludePaths);
+            if (!options.macros.empty() || !options.skippedMacros.empty())
+                query._nameFilter.emplace(options.macros, options.skippedMacros);
+            // The token cache validates its entries against the files on disk,
+            // which are not what is preprocessed when files are kept in memory.
+            if (!options.tokenCacheDirectory.empty() && options.wantsFilesWritten && options.stdinFile.empty())
+                query._tokenCache.emplace(options.tokenCacheDirectory);
+        }
+    }  // namespace
+
     Search::Search(SourceVector& files)
         :_sourcelist(files){
         for (auto &file : _sourcelist)
             file = Routines::makeAbsolute(file);
     }
 
+    void Search::onProgress(ProgressCallback callback) {
+        _progress = std::move(callback);
+    }
+
     Result Search::run(clang::tooling::CompilationDatabase& compilationDatabase,
         const Options& options) {
         Query query(options);
+        query.progress = _progress;
+        _unchangedFiles.clear();
+        if (options.shardCount > 1)
+            _selectShard(options);
+        query._fileCache = std::make_shared<FileCache>();
+        if (!options.includeCacheFile.empty())
+            query.statistics.missingFilesPreloaded = query._fileCache->loadMissingFiles(options.includeCacheFile);
+        if (!options.stdinFile.empty())
+            query._fileCache->replace(Routines::makeAbsolute(options.stdinFile), options.stdinContents);
+        configure(query);
+        if (!options.since.empty()) {
+            query._changes = Changes::fromGit(options.since);
+            auto includeGraphFile = options.includeGraphFile;
+            if (includeGraphFile.empty()) {
+                llvm::SmallString<256> path(query._changes->gitDirectory);
+                llvm::sys::path::append(path, "macro-expand-include-graph.json");
+                includeGraphFile = path.str();
+            }
+            query._includeGraph = std::make_shared<IncludeGraph>(includeGraphFile);
+        }
+        else if (options.wantsChangedLinesOnly) {
+            throw Routines::ErrorCode{ "-changed-lines-only requires -since" };
+        }
+        else if (!options.includeGraphFile.empty()) {
+            query._includeGraph = std::make_shared<IncludeGraph>(options.includeGraphFile);
+        }
+
+        _journal.reset();
+        if (!options.journalDirectory.empty())
+            _journal = std::make_shared<Journal>(options.journalDirectory, journalOptionsOf(options));
+
+        {
+            Statistics::Timer timer(query.statistics, "callsiteExpand");
+            _callsiteExpand(compilationDatabase, query);
+        }
+        if (!options.includeCacheFile.empty())
+            query._fileCache->saveMissingFiles(options.includeCacheFile);
+        if (query._includeGraph)
+            query._includeGraph->save();
+        // Without `-rewrite`, expansions and removals from main files are only
+        // reported.
+        if (!options.wantsRewritten && options.exportFixesFile.empty())
+            query._replacements.clear();
+        // Other shards may use the header definitions this one did not.
+        if (options.shardCount <= 1) {
+            Statistics::Timer timer(query.statistics, "cleanHeaderFiles");
+            _cleanHeaderFiles(query);
+        }
+        if (!options.exportFixesFile.empty()) {
+            exportFixes(options.exportFixesFile, std::move(query._replacements));
+        }
+        else if (options.shardCount <= 1) {
+            Statistics::Timer timer(query.statistics, "applyEdits");
+            _applyEdits(query);
+        }
+        // A shard leaves its edits to the merge: other shards may edit the same
+        // headers, and the header removals are only known once all are merged.
+        if (_journal) {
+            _journal->remove();
+            _journal.reset();
+        }
+        query.statistics.peakResidentBytes = Routines::peakResidentBytes();
+
+        return Result(std::move(query));
+    }
+
+    nlohmann::json Search::merge(const std::vector<std::string>& shardFiles,
+        const Options& options) {
+        Query query(options);
+        query._fileCache = std::make_shared<FileCache>();
+        nlohmann::json macros = nlohmann::json::array();
+        unsigned shardCount = 0;
+        std::vector<bool> seen;
+        for (const auto& file : shardFiles) {
+            auto buffer = llvm::MemoryBuffer::getFile(file);
+            if (!buffer)
+                throw Routines::ErrorCode{ "could not read " + file };
+            // Anything missing or of the wrong type means the file came from
+            // somewhere else.
+            try {
+                auto shard = nlohmann::json::parse((*buffer)->getBuffer().str());
+                const auto index = shard.at("shard").at("index").get<unsigned>();
+                const auto count = shard.at("shard").at("count").get<unsigned>();
+                if (shardCount == 0) {
+                    shardCount = count;
+                    seen.assign(count, false);
+                }
+                if (count != shardCount || index >= count)
+                    throw Routines::ErrorCode{ file + " is from a run with a different number of shards" };
+                if (seen[index])
+                    throw Routines::ErrorCode{ file + " repeats shard " + std::to_string(index) };
+                seen[index] = true;
 
-        _callsiteExpand(compilationDatabase, query);
+                for (auto& macro : shard.at("macros"))
+                    macros.push_back(std::move(macro));
+                // Paths are relative to the working directory of the shard, which
+                // is the same place in this checkout.
+                for (const auto& edit : shard.at("edits")) {
+                    query._replacements.emplace_back(Routines::makeAbsolute(edit.at("file").get<std::string>()),
+                        edit.at("offset").get<unsigned>(),
+                        edit.at("length").get<unsigned>(),
+                        edit.at("text").get<std::string>());
+                }
+                // A header definition is unused if no shard uses it.
+                for (const auto& definition : shard.at("headerDefinitions")) {
+                    const auto& location = definition.at("location");
+                    Location key(Routines::makeAbsolute(location.at("filename").get<std::string>()),
+                        location.at("offset").at("line").get<unsigned>(),
+                        location.at("offset").at("column").get<unsigned>());
+                    const auto id = query._headerDefinitions.add(std::move(key));
+                    if (definition.at("uses").get<std::size_t>() > 0)
+                        query._headerDefinitions.markUsed(id);
+                }
+            }
+            catch (const std::exception&) {
+                throw Routines::ErrorCode{ file + " is not the output of a sharded run" };
+            }
+        }
+        // Without every shard, unused definitions cannot be told apart.
+        const auto missing = std::find(seen.begin(), seen.end(), false);
+        if (missing != seen.end())
+            throw Routines::ErrorCode{ "shard " + std::to_string(missing - seen.begin()) + " is missing" };
+
+        // The edits of every shard and the removals from headers all apply to
+        // the original files, in one pass.
         _cleanHeaderFiles(query);
+        _applyEdits(query);
+        return macros;
+    }
 
-        return Result(std::move(query));
+    void Search::watch(CompilationDatabase& compilationDatabase,
+        const Options& options,
+        const WatchCallback& onUpdate) {
+        // Watching reports findings to an editor; it never writes files, which
+        // would also trigger another round.
+        auto watchOptions = options;
+        watchOptions.wantsRewritten = false;
+        watchOptions.wantsUnusedRemoved = false;
+        watchOptions.wantsChangedLinesOnly = false;
+        watchOptions.exportFixesFile.clear();
+
+        FileWatcher watcher;
+        // Saving these every round would otherwise start the next one.
+        for (const auto& file : { options.includeGraphFile, options.timingHistoryFile, options.includeCacheFile }) {
+            if (!file.empty())
+                watcher.ignore(file);
+        }
+        auto fileCache = std::make_shared<FileCache>();
+        auto includeGraph = std::make_shared<IncludeGraph>(options.includeGraphFile);
+        FileWatcher::Changes changes;
+        for (bool isFirst = true;; isFirst = false) {
+            Query query(watchOptions);
+            query.progress = _progress;
+            query._fileCache = fileCache;
+            query._includeGraph = includeGraph;
+            configure(query);
+            if (!isFirst && !changes.overflowed)
+                query._changes = Changes::fromFiles(changes.paths);
+
+            _unchangedFiles.clear();
+            _affectedFiles.clear();
+            bool succeeded = true;
+            try {
+                Statistics::Timer timer(query.statistics, "callsiteExpand");
+                _callsiteExpand(compilationDatabase, query);
+            }
+            catch (const Routines::ErrorCode&) {
+                // Compile errors are expected while editing; report and go on.
+                succeeded = false;
+            }
+            includeGraph->save();
+            query.statistics.peakResidentBytes = Routines::peakResidentBytes();
+            onUpdate(changes.paths, _affectedFiles, Result(std::move(query)), succeeded);
+
+            for (const auto& file : _sourcelist)
+                watcher.watchDirectoryOf(file);
+            for (const auto& file : includeGraph->files())
+                watcher.watchDirectoryOf(file);
+            changes = watcher.wait(std::chrono::milliseconds(100));
+            if (changes.overflowed) {
+                fileCache = std::make_shared<FileCache>();
+                continue;
+            }
+            // Spelled the way the cache keys files, however they were included.
+            for (const auto& path : changes.paths)
+                fileCache->invalidate(Routines::makeAbsolute(path));
+        }
     }
 
     void Search::_callsiteExpand(CompilationDatabase& compilationDatabase, Query& query) {
-        clang::tooling::ClangTool MacroExpand(compilationDatabase, _sourcelist );
-        tidy::MacroExpand::ActionFactory actionFactory(query);
-        const auto error = MacroExpand.run( &actionFactory);
-        if (error)
+        // Running the driver (toolchain detection, include paths, -cc1 argument
+        // parsing) is the same for the whole group, so do it once, and only once
+        // for all runs of `watch()`. Its paths are made absolute, so nothing
+        // after it depends on the working directory.
+        if (!_isPrepared) {
+            llvm::SmallString<256> initialDirectory;
+            if (llvm::sys::fs::current_path(initialDirectory))
+                throw Routines::ErrorCode{ "could not get the working directory" };
+            _groups = _groupCompileCommands(compilationDatabase, query);
+            query.statistics.compileCommandGroups += _groups.size();
+            for (const auto& group : _groups) {
+                _enterDirectory(group.directory);
+                _invocations.push_back(_createInvocation(group));
+                if (_invocations.back())
+                    makePathsAbsolute(*_invocations.back(), group.directory);
+                else
+                    _driverFailed = true;
+            }
+            llvm::sys::fs::set_current_path(initialDirectory);
+            _timingHistory = std::make_shared<TimingHistory>(query.options.timingHistoryFile);
+            _isPrepared = true;
+        }
+        const auto& groups = _groups;
+        const auto& invocations = _invocations;
+
+        llvm::Optional<MacroExpand::Prescan> prescan;
+        if (query.options.wantsPrescan) {
+            prescan.emplace(query._fileCache);
+            // Keeping unused definitions, only translation units using a project
+            // macro matter. Which names those are is only known after seeing the
+            // definitions of all translation units.
+            if (!query.options.wantsUnusedRemoved) {
+                Statistics::Timer timer(query.statistics, "prescan");
+                for (std::size_t index = 0; index < groups.size(); ++index) {
+                    if (!invocations[index])
+                        continue;
+                    for (const auto& unit : groups[index].units)
+                        prescan->collectDefinitions(*invocations[index], Routines::absoluteIn(groups[index].directory, unit.filename));
+                }
+                prescan->buildNameFilter();
+            }
+        }
+
+        // A translation unit to preprocess.
+        struct Task {
+            /// The index of its group.
+            std::size_t group;
+
+            /// The index of its unit within the group.
+            std::size_t unit;
+
+            /// Its absolute main file.
+            std::string mainFile;
+
+            /// Its key in the timing history.
+            std::string historyKey;
+        };
+
+        // Decide which translation units to preprocess.
+        std::vector<Task> tasks;
+        for (std::size_t index = 0; index < groups.size(); ++index) {
+            const auto& group = groups[index];
+            const auto& invocation = invocations[index];
+            if (!invocation)
+                continue;
+
+            for (std::size_t unitIndex = 0; unitIndex < group.units.size(); ++unitIndex) {
+                const auto& unit = group.units[unitIndex];
+                auto mainFile = Routines::absoluteIn(group.directory, unit.filename);
+                if (query._changes && !query._includeGraph->isAffected(mainFile, *query._changes)) {
+                    _unchangedFiles.push_back(mainFile);
+                    ++query.statistics.translationUnitsUnchanged;
+                    continue;
+                }
+                _affectedFiles.push_back(mainFile);
+
+                // Unused definitions in a file preprocessed in several
+                // configurations may only be removed once every configuration
+                // has had its say.
+                if (unit.configurations > 1)
+                    query._pendingConfigurations.emplace(mainFile, unit.configurations);
+
+                if (prescan) {
+                    Statistics::Timer timer(query.statistics, "prescan");
+                    const auto unitInvocation = invocationFor(*invocation, mainFile);
+                    if (!prescan->mayDefineMacros(*unitInvocation, mainFile) ||
+                        (!query.options.wantsUnusedRemoved && !prescan->mayUseMacros(*unitInvocation, mainFile))) {
+                        ++query.statistics.translationUnitsSkipped;
+                        continue;
+                    }
+                }
+                auto historyKey = mainFile;
+                if (unit.configurations > 1)
+                    historyKey += '\n' + unit.configuration;
+                tasks.push_back({ index, unitIndex, std::move(mainFile), std::move(historyKey) });
+            }
+        }
+
+        // Translation units an interrupted run finished are replayed from the
+        // journal instead of preprocessed again.
+        std::vector<UnitRecords> records(tasks.size());
+        std::vector<std::size_t> remaining;
+        for (std::size_t index = 0; index < tasks.size(); ++index) {
+            const auto& task = tasks[index];
+            auto& unitRecords = records[index];
+            if (!_journal || !_journal->replay(task.historyKey, query._headerDefinitions, unitRecords)) {
+                remaining.push_back(index);
+                continue;
+            }
+            for (const auto& definition : unitRecords.headerDefinitions) {
+                if (definition.second)
+                    query._headerDefinitions.markUsed(definition.first);
+            }
+            const auto pending = query._pendingConfigurations.find(task.mainFile);
+            if (pending != query._pendingConfigurations.end() && query.options.wantsUnusedRemoved) {
+                for (const auto& uses : unitRecords.mainFileDefinitionUses) {
+                    auto& highest = query._mainFileDefinitionUses[uses.first];
+                    highest = std::max(highest, uses.second);
+                }
+                if (--pending->second == 0)
+                    query._pendingConfigurations.erase(pending);
+            }
+            // What a replayed translation unit read is not known; the next
+            // incremental run treats it as affected.
+            if (query._includeGraph)
+                query._includeGraph->forget(task.mainFile);
+            query.statistics += unitRecords.statistics;
+            ++query.statistics.translationUnitsReplayed;
+        }
+
+        // Predict the cost of every translation unit: its time in the last run,
+        // or else its weight, scaled to seconds like the weights of those with
+        // a history. Reading the main files for their weights fills the file
+        // cache, so preprocessing does not read them again.
+        const Scheduler scheduler(jobsOf(query.options));
+        std::vector<double> costs(remaining.size(), -1);
+        bool hasUnknownCosts = false;
+        for (std::size_t task = 0; task < remaining.size(); ++task) {
+            if (const auto seconds = _timingHistory->secondsOf(tasks[remaining[task]].historyKey))
+                costs[task] = *seconds;
+            else
+                hasUnknownCosts = true;
+        }
+        if (hasUnknownCosts) {
+            Statistics::Timer timer(query.statistics, "schedule");
+            std::vector<double> weights(remaining.size());
+            scheduler.run(std::vector<double>(remaining.size()), [&](std::size_t task) {
+                weights[task] = weightOf(*query._fileCache, tasks[remaining[task]].mainFile);
+            });
+            double knownSeconds = 0;
+            double knownWeight = 0;
+            for (std::size_t task = 0; task < remaining.size(); ++task) {
+                if (costs[task] >= 0) {
+                    knownSeconds += costs[task];
+                    knownWeight += weights[task];
+                }
+            }
+            const double secondsPerWeight = knownWeight > 0 ? knownSeconds / knownWeight : 1;
+            for (std::size_t task = 0; task < remaining.size(); ++task) {
+                if (costs[task] < 0)
+                    costs[task] = weights[task] * secondsPerWeight;
+            }
+        }
+
+        // Stage one: preprocess the translation units in parallel, longest
+        // first. Nothing is written; every translation unit records its findings
+        // and edits, against the files as read, into its own `UnitRecords`.
+        std::atomic<bool> failed(_driverFailed);
+        scheduler.run(costs, [&](std::size_t next) {
+            const auto index = remaining[next];
+            const auto& task = tasks[index];
+            const auto& group = groups[task.group];
+            const auto& unit = group.units[task.unit];
+            auto& unitRecords = records[index];
+            if (unit.configurations > 1)
+                unitRecords.configuration = unit.configuration;
+
+            // Unlike `clang::tooling::ClangTool`, every translation unit gets
+            // a fresh `FileManager`; they all share the run-wide file cache.
+            llvm::IntrusiveRefCntPtr<clang::vfs::FileSystem> fileSystem(
+                new CachingFileSystem(query._fileCache, group.directory));
+            llvm::IntrusiveRefCntPtr<clang::FileManager> files(
+                new clang::FileManager(clang::FileSystemOptions(), fileSystem));
+            MacroExpand::ActionFactory actionFactory(query, unitRecords);
+            const auto start = std::chrono::steady_clock::now();
+            const bool succeeded = actionFactory.runInvocation(invocationFor(*invocations[task.group], task.mainFile),
+                files.get(),
+                std::make_shared<clang::PCHContainerOperations>(),
+                /*DiagConsumer=*/nullptr);
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            _timingHistory->record(task.historyKey, elapsed.count());
+            if (!succeeded)
+                failed = true;
+            // Translation units with errors run again when the run is resumed.
+            else if (_journal && unitRecords.statistics.failedTranslationUnits == 0)
+                _journal->record(task.historyKey, unitRecords, query._headerDefinitions);
+        });
+        _timingHistory->save();
+
+        // Merge in the order the translation units were given, so the result
+        // does not depend on how they were spread over threads.
+        for (auto& unitRecords : records) {
+            // Every translation unit including a header expands its calls the
+            // same way; applying the edits drops the identical ones.
+            for (auto& expansion : unitRecords.expansions) {
+                query._macroInvocations.push_back(std::move(expansion.macro));
+                query._replacements.push_back(std::move(expansion.replacement));
+            }
+            std::move(unitRecords.removals.begin(), unitRecords.removals.end(),
+                std::back_inserter(query._replacements));
+        }
+        if (failed)
             throw Routines::ErrorCode{ "fatal error" };
     }
 
+    void Search::_selectShard(const Options& options) {
+        SourceVector selected;
+        if (options.wantsShardsBySize) {
+            // Longest processing time first: the largest remaining source goes
+            // to the shard with the fewest bytes so far. Ties break by path, so
+            // every shard computes the same assignment.
+            std::vector<std::pair<std::uint64_t, std::string>> sources;
+            for (const auto& file : _sourcelist) {
+                std::uint64_t size = 0;
+                llvm::sys::fs::file_size(file, size);
+                sources.emplace_back(size, file);
+            }
+            std::sort(sources.begin(), sources.end(),
+                [](const std::pair<std::uint64_t, std::string>& first,
+                    const std::pair<std::uint64_t, std::string>& second) {
+                    return first.first != second.first ? first.first > second.first : first.second < second.second;
+                });
+            std::vector<std::uint64_t> load(options.shardCount, 0);
+            for (const auto& source : sources) {
+                const auto shard = std::min_element(load.begin(), load.end()) - load.begin();
+                load[shard] += std::max<std::uint64_t>(source.first, 1);
+                if (static_cast<unsigned>(shard) == options.shardIndex)
+                    selected.push_back(source.second);
+            }
+        }
+        else {
+            // Hash the path relative to the working directory, so checkouts in
+            // different places agree.
+            for (const auto& file : _sourcelist) {
+                if (stableHash(Routines::makeRelative(file)) % options.shardCount == options.shardIndex)
+                    selected.push_back(file);
+            }
+        }
+        _sourcelist = std::move(selected);
+    }
+
+    void Search::_enterDirectory(const std::string& directory) const {
+        // The driver resolves the relative paths of a command line against the
+        // working directory.
+        if (llvm::sys::fs::set_current_path(directory))
+            throw Routines::ErrorCode{ "could not change to " + directory };
+    }
+
+    std::shared_ptr<clang::CompilerInvocation> Search::_createInvocation(const CommandGroup& group) const {
+        std::vector<const char*> arguments;
+        for (const auto& argument : group.commandLine)
+            arguments.push_back(argument.c_str());
+        std::shared_ptr<clang::CompilerInvocation> invocation(
+            clang::createInvocationFromCommandLine(arguments,
+                clang::CompilerInstance::createDiagnostics(new clang::DiagnosticOptions())));
+        if (invocation) {
+            invocation->getFrontendOpts().DisableFree = false;
+            invocation->getCodeGenOpts().DisableFree = false;
+        }
+        return invocation;
+    }
+
+    std::vector<Search::CommandGroup> Search::_groupCompileCommands(
+        CompilationDatabase& compilationDatabase, Query& query) const {
+        const auto adjuster = clang::tooling::combineAdjusters(
+            clang::tooling::getClangStripOutputAdjuster(),
+            clang::tooling::getClangSyntaxOnlyAdjuster());
+        const auto executable = mainExecutable();
+
+        std::vector<CommandGroup> groups;
+        std::unordered_map<std::string, std::size_t> groupIndices;
+        std::unordered_set<std::string> seen;
+        std::unordered_map<std::string, std::size_t> configurations;
+        for (const auto& file : _sourcelist) {
+            const auto commands = compilationDatabase.getCompileCommands(file);
+            if (commands.empty()) {
+                llvm::errs() << "Skipping " << file << ". Compile command not found.\n";
+                continue;
+            }
+            for (const auto& command : commands) {
+                // The normalized command is the command line with the file
+                // replaced by a placeholder. The compiler and the extension are
+                // part of it, since the driver picks the language from them.
+                // Commands naming the file more than once are left on their own.
+                std::string key = command.Directory;
+                key += '\0';
+                key += command.CommandLine.front();
+                key += '\0';
+                key += llvm::sys::path::extension(command.Filename);
+
+                auto commandLine = adjuster(command.CommandLine, command.Filename);
+                commandLine.front() = executable;
+                std::size_t occurrences = 0;
+                for (const auto& argument : commandLine) {
+                    key += '\0';
+                    if (argument == command.Filename) {
+                        key += "\1<input>";
+                        ++occurrences;
+                    }
+                    else {
+                        key += argument;
+                    }
+                }
+                if (occurrences != 1)
+                    key = "\2" + std::to_string(groups.size());
+
+                const auto absolute = Routines::absoluteIn(command.Directory, command.Filename);
+                if (!seen.insert(key + '\0' + absolute).second) {
+                    ++query.statistics.duplicateCommandsSkipped;
+                    continue;
+                }
+                ++configurations[absolute];
+
+                auto configuration = macroArguments(commandLine);
+                const auto inserted = groupIndices.emplace(key, groups.size());
+                if (inserted.second)
+                    groups.push_back({ command.Directory, std::move(commandLine), {} });
+                groups[inserted.first->second].units.push_back({ command.Filename, std::move(configuration), 0 });
+            }
+        }
+
+        for (auto& group : groups) {
+            for (auto& unit : group.units) {
+                unit.configurations = configurations[Routines::absoluteIn(group.directory, unit.filename)];
+                if (unit.configurations > 1)
+                    ++query.statistics.multiConfigurationUnits;
+            }
+        }
+        return groups;
+    }
+
     void Search::_cleanHeaderFiles(Query& query) {
         if (!query.options.wantsUnusedRemoved)
             return;
+        // Headers read by translation units skipped as unchanged may well use
+        // their definitions; only the full run can tell.
+        llvm::StringSet<> skippedHeaders;
+        if (query._changes && !_unchangedFiles.empty())
+            skippedHeaders = query._includeGraph->filesReadBy(_unchangedFiles);
         std::unordered_map<std::string, std::vector<size_t>> linesToDelete;
-        for (const auto&it : query._macroDefinitionsInHeaders)
+        for (unsigned id = 0; id < query._headerDefinitions.size(); ++id)
         {
-            if (it.second.first == 0) {
+            if (query._headerDefinitions.isUsed(id))
+                continue;
+            const auto location = query._headerDefinitions.locationOf(id);
+            if (!skippedHeaders.count(Routines::makeAbsolute(location.filename))) {
                 //delete those lines
-                linesToDelete[it.first.filename].push_back(it.first.offset.line);
+                linesToDelete[location.filename].push_back(location.offset.line);
             }
         }
         for (auto&it : linesToDelete)
         {
             std::sort(it.second.begin(), it.second.end());
-            auto last = std::unique(it.second.begin(), it.second.end());
-            it.second.erase(last, it.second.end());
-            std::ifstream fid;
-            std::ostringstream ss;
-            fid.open(it.first);
-            int lineno = 0;
+            // Read through the file cache, like the translation units did, so the
+            // offsets match theirs.
+            const auto path = Routines::makeAbsolute(it.first);
+            const auto original = query._fileCache->contents(path);
+            if (!original)
+                throw Routines::ErrorCode{ "could not read " + path };
+            std::istringstream fid((*original)->getBuffer().str());
+            size_t lineno = 0;
+            std::size_t offset = 0;
             std::string data;
             while (std::getline(fid, data))
             {
                 ++lineno;
-                if (std::find(it.second.begin(), it.second.end(), lineno) != it.second.end())
+                const auto length = data.size() + (fid.eof() ? 0 : 1);
+                offset += length;
+                // Several definitions may share a line; count each one removed.
+                const auto definitions = std::equal_range(it.second.begin(), it.second.end(), lineno);
+                if (definitions.first == definitions.second)
                     continue;
-                ss << data << std::endl;
+                query._replacements.emplace_back(path, offset - length, length, "");
+                query.statistics.definitionsRemoved += definitions.second - definitions.first;
+            }
+        }
+    }
+
+    void Search::_applyEdits(Query& query) {
+        auto& edits = query._replacements;
+        std::sort(edits.begin(), edits.end());
+        edits.erase(std::unique(edits.begin(), edits.end()), edits.end());
+
+        // Sorted, the edits of each file are next to each other.
+        std::vector<std::pair<std::size_t, std::size_t>> files;
+        for (std::size_t begin = 0, end; begin < edits.size(); begin = end) {
+            for (end = begin + 1; end < edits.size() && edits[end].getFilePath() == edits[begin].getFilePath(); ++end) {
             }
-            if (!fid.eof())
-                break;
-            fid.close();
-            std::ofstream fid_out(it.first);
-            fid_out << ss.str();
-            assert(fid_out.good());
-            fid_out.close();
+            files.emplace_back(begin, end);
+        }
+
+        // Stage two: every file is read (from the file cache, which the
+        // translation units already filled) and written once, files in parallel,
+        // those with the most edits first. Writing to disk is left to a writer
+        // thread, so rewriting the next file need not wait for it.
+        llvm::Optional<FileWriter> writer;
+        if (query.options.wantsFilesWritten) {
+            writer.emplace(kWriteBufferBytes, [&query](const std::string& path) {
+                query._fileCache->invalidate(path);
+            });
         }
+        std::vector<double> costs;
+        for (const auto& file : files)
+            costs.push_back(static_cast<double>(file.second - file.first));
+        Scheduler(jobsOf(query.options)).run(costs, [&](std::size_t index) {
+            const auto path = edits[files[index].first].getFilePath().str();
+            const auto original = query._fileCache->contents(path);
+            if (!original)
+                throw Routines::ErrorCode{ "could not read " + path };
+            const auto text = (*original)->getBuffer();
+            const auto isJournaled = _journal && query.options.wantsFilesWritten;
+            // The interrupted run this one resumes made these edits already.
+            if (isJournaled && _journal->isWritten(path, text))
+                return;
+
+            std::string contents;
+            contents.reserve(text.size());
+            std::size_t offset = 0;
+            std::size_t dropped = 0;
+            for (auto edit = files[index].first; edit < files[index].second; ++edit) {
+                // Overlapping edits come from translation units that saw the file
+                // differently, e.g. in another configuration. The first one wins,
+                // as if the others had seen the file it rewrote.
+                const auto& replacement = edits[edit];
+                if (replacement.getOffset() < offset ||
+                    replacement.getOffset() + replacement.getLength() > text.size()) {
+                    ++dropped;
+                    continue;
+                }
+                contents.append(text.data() + offset, replacement.getOffset() - offset);
+                contents += replacement.getReplacementText();
+                offset = replacement.getOffset() + replacement.getLength();
+            }
+            contents.append(text.data() + offset, text.size() - offset);
+
+            {
+                std::lock_guard<std::mutex> lock(query._mutex);
+                query.statistics.bytesWritten += contents.size();
+                query.statistics.editsDropped += dropped;
+            }
+            if (writer) {
+                if (isJournaled)
+                    _journal->recordWriting(path, text, contents);
+                writer->write(path, std::move(contents));
+                return;
+            }
+            TIDY_PROBE2(file__write, path.c_str(), contents.size());
+            query._fileCache->replace(path, contents);
+            std::lock_guard<std::mutex> lock(query._mutex);
+            query._writtenFiles[path] = std::move(contents);
+        });
+        if (writer)
+            writer->finish();
     }
 
 }  // namespace tidy
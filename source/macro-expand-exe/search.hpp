@@ -7,11 +7,18 @@
 // Project includes
 #include "misra-tidy/common/location.hpp"
 
+// Third party includes
+#include <third-party/json.hpp>
+
 // Standard includes
+#include <cstddef>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace clang {
+    class CompilerInvocation;
     namespace tooling {
         class CompilationDatabase;
     }
@@ -21,26 +28,135 @@ namespace tidy {
     struct Query;
     struct Result;
     struct Options;
+    struct Statistics;
+    class Journal;
+    class TimingHistory;
     class Search {
     public:
         using CompilationDatabase = clang::tooling::CompilationDatabase;
         using SourceVector = std::vector<std::string>;
+        using ProgressCallback = std::function<void(const Statistics&)>;
+
+        /// Receives the paths that changed (none for the first run), the main
+        /// files of the translation units run again, their `Result` and whether
+        /// all of them preprocessed without errors.
+        using WatchCallback = std::function<void(const std::vector<std::string>&,
+            const std::vector<std::string>&,
+            const Result&,
+            bool)>;
 
         /// Constructs a new `Search` object with a vector of all the files being searched
         Search(SourceVector& files);
 
+        /// Registers a callback that receives the statistics of the ongoing run
+        /// after every translation unit.
+        void onProgress(ProgressCallback callback);
+
         /// Runs the search on the given sources and with the given options.
         /// \returns A `Result`, ready to be printed to the console.
         Result run(CompilationDatabase& compilationDatabase,
             const Options& options);
 
+        /// Combines the outputs of the sharded runs in `shardFiles`, which must
+        /// cover every shard: concatenates their macro records, merges which
+        /// header definitions each used and removes those no shard used (if
+        /// `options` want unused definitions removed).
+        /// \returns The macro records of all shards.
+        nlohmann::json merge(const std::vector<std::string>& shardFiles,
+            const Options& options);
+
+        /// Runs the search on all sources, then again on the translation units
+        /// affected by every change to a file they read, until the process is
+        /// killed. Files are never written. The compiler invocations, the file
+        /// cache and the include graph stay in memory between runs.
+        void watch(CompilationDatabase& compilationDatabase,
+            const Options& options,
+            const WatchCallback& onUpdate);
+
     private:
+        /// A source file to preprocess with the command of its `CommandGroup`.
+        struct Unit {
+            /// The file, as named by its compile command.
+            std::string filename;
+
+            /// The macros defined and undefined by the command, e.g. `-DNDEBUG`.
+            std::string configuration;
+
+            /// The number of distinct commands the file is preprocessed with.
+            std::size_t configurations;
+        };
+
+        /// Source files sharing the same normalized compile command.
+        struct CommandGroup {
+            /// The directory the command runs in.
+            std::string directory;
+
+            /// The adjusted command line of the first file in the group.
+            std::vector<std::string> commandLine;
+
+            /// The files preprocessed with the command.
+            std::vector<Unit> units;
+        };
+
+        /// Looks up the compile commands of all sources and groups them by
+        /// normalized command, in the order the sources were given. A file
+        /// listed more than once with the same normalized command is only
+        /// grouped once.
+        std::vector<CommandGroup> _groupCompileCommands(CompilationDatabase& compilationDatabase,
+            Query& query) const;
+
+        /// Keeps only the sources of shard `options.shardIndex`. Every shard
+        /// computes the same partition, independently of the others.
+        void _selectShard(const Options& options);
+
+        /// Changes the working directory of the process to that of a compile
+        /// command.
+        void _enterDirectory(const std::string& directory) const;
+
+        /// Runs the driver on the command line of `group`. Must be called from
+        /// the group's directory.
+        /// \returns The compiler invocation, or null if the driver failed.
+        std::shared_ptr<clang::CompilerInvocation> _createInvocation(const CommandGroup& group) const;
+
         /// Performs the symbol search (& expand) phase. Decorates the `Query` with
-        /// `DeclarationData` and `CallData`, as well as possibly `DefinitionData`.
+        /// `DeclarationData` and `CallData`, as well as possibly `DefinitionData`,
+        /// and collects the edits to make, without writing anything. Translation
+        /// units run in parallel, those predicted to take longest first.
         void _callsiteExpand(CompilationDatabase& compilationDatabase,  Query& query);
-        /// Performs the header cleanup phase.
+        /// Performs the header cleanup phase: adds the removal of every header
+        /// definition no translation unit used to the edits of the `Query`.
         void _cleanHeaderFiles(Query& query);
+        /// Applies the edits of the `Query`, in parallel across files. Each file
+        /// is read and written once.
+        void _applyEdits(Query& query);
         SourceVector& _sourcelist;
+        ProgressCallback _progress;
+
+        /// The absolute main files of the translation units skipped because
+        /// nothing they read changed since `-since`.
+        std::vector<std::string> _unchangedFiles;
+
+        /// The absolute main files of the translation units not skipped as
+        /// unchanged in the last run.
+        std::vector<std::string> _affectedFiles;
+
+        /// Whether `_groups` and `_invocations` are set up.
+        bool _isPrepared = false;
+
+        /// The compile commands, grouped.
+        std::vector<CommandGroup> _groups;
+
+        /// The compiler invocation of each group, or null if the driver failed.
+        std::vector<std::shared_ptr<clang::CompilerInvocation>> _invocations;
+
+        /// Whether the driver failed for any group.
+        bool _driverFailed = false;
+
+        /// How long each translation unit took, to start the longest first.
+        std::shared_ptr<TimingHistory> _timingHistory;
+
+        /// The journal of the ongoing run, if `-journal` is given.
+        std::shared_ptr<Journal> _journal;
     };
 }  // namespace tidy
 
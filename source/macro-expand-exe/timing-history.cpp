@@ -0,0 +1,81 @@
+// Project includes
+#include "timing-history.hpp"
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// LLVM includes
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Standard includes
+#include <exception>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace tidy {
+
+    TimingHistory::TimingHistory(std::string filename)
+        : _filename(std::move(filename)) {
+        if (_filename.empty())
+            return;
+        auto buffer = llvm::MemoryBuffer::getFile(_filename);
+        if (!buffer)
+            return;
+        nlohmann::json history;
+        try {
+            history = nlohmann::json::parse((*buffer)->getBuffer().str());
+        }
+        catch (const std::exception&) {
+            return;
+        }
+        if (!history.is_object() || !history.count("translationUnits"))
+            return;
+        for (auto it = history["translationUnits"].begin(); it != history["translationUnits"].end(); ++it) {
+            if (it.value().is_number())
+                _seconds[it.key()] = it.value().get<double>();
+        }
+    }
+
+    llvm::Optional<double> TimingHistory::secondsOf(llvm::StringRef key) const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const auto found = _seconds.find(key);
+        if (found == _seconds.end())
+            return llvm::None;
+        return found->second;
+    }
+
+    void TimingHistory::record(llvm::StringRef key, double seconds) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _seconds[key] = seconds;
+    }
+
+    void TimingHistory::save() const {
+        if (_filename.empty())
+            return;
+        nlohmann::json history;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            history["translationUnits"] = nlohmann::json::object();
+            for (const auto& unit : _seconds)
+                history["translationUnits"][unit.first().str()] = unit.second;
+        }
+
+        const auto temporary = _filename + ".tmp";
+        {
+            std::error_code error;
+            llvm::raw_fd_ostream stream(temporary, error, llvm::sys::fs::F_Text);
+            if (error) {
+                llvm::errs() << "Could not write " << temporary << ": " << error.message() << '\n';
+                return;
+            }
+            stream << history.dump();
+        }
+        if (const auto error = llvm::sys::fs::rename(temporary, _filename))
+            llvm::errs() << "Could not write " << _filename << ": " << error.message() << '\n';
+    }
+
+}  // namespace tidy
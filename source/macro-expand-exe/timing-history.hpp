@@ -0,0 +1,50 @@
+#ifndef MACRO_EXPAND_TIMING_HISTORY_HPP
+#define MACRO_EXPAND_TIMING_HISTORY_HPP
+
+// LLVM includes
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+
+// Standard includes
+#include <mutex>
+#include <string>
+
+namespace tidy {
+    /// How long each translation unit took to preprocess, across runs.
+    ///
+    /// The history predicts the cost of a translation unit from its last run,
+    /// so the longest ones can be started first. It is kept as JSON mapping
+    /// each translation unit (its absolute main file, followed by its
+    /// configuration if it has one) to seconds. Translation units not run
+    /// again keep their entries.
+    class TimingHistory {
+    public:
+        /// Loads the history saved to `filename`. A missing or unreadable file
+        /// starts an empty history; an empty `filename` one that is never
+        /// saved.
+        explicit TimingHistory(std::string filename = "");
+
+        /// Returns the seconds the translation unit `key` took when last run,
+        /// if it ever was.
+        llvm::Optional<double> secondsOf(llvm::StringRef key) const;
+
+        /// Records that the translation unit `key` took `seconds`.
+        void record(llvm::StringRef key, double seconds);
+
+        /// Writes the history back to its file, replacing it atomically.
+        void save() const;
+
+    private:
+        /// The file the history is kept in, or empty.
+        std::string _filename;
+
+        /// Guards `_seconds`; translation units finish on several threads.
+        mutable std::mutex _mutex;
+
+        /// The seconds of every translation unit ever recorded.
+        llvm::StringMap<double> _seconds;
+    };
+}  // namespace tidy
+
+#endif  // MACRO_EXPAND_TIMING_HISTORY_HPP
@@ -0,0 +1,131 @@
+// Project includes
+#include "misra-tidy/common/unified-diff.hpp"
+
+// LLVM includes
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Standard includes
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+    constexpr unsigned kRounds = 1000;
+
+    /// Returns a version of a file with up to `maxLines` lines.
+    std::vector<std::string> randomLines(std::mt19937& random, unsigned maxLines) {
+        std::vector<std::string> lines(random() % (maxLines + 1));
+        for (auto& line : lines)
+            line = std::string(1, static_cast<char>('a' + random() % 4));
+        return lines;
+    }
+
+    /// Returns `lines` after random removals, insertions and replacements.
+    std::vector<std::string> edited(std::mt19937& random, std::vector<std::string> lines) {
+        const auto edits = random() % 6;
+        for (unsigned edit = 0; edit < edits; ++edit) {
+            const auto at = lines.empty() ? 0 : random() % (lines.size() + 1);
+            switch (random() % 3) {
+            case 0:
+                if (at < lines.size())
+                    lines.erase(lines.begin() + at, lines.begin() + std::min<std::size_t>(lines.size(), at + 1 + random() % 3));
+                break;
+            case 1:
+                for (auto count = 1 + random() % 3; count > 0; --count)
+                    lines.insert(lines.begin() + at, std::string(1, static_cast<char>('a' + random() % 6)));
+                break;
+            default:
+                if (at < lines.size())
+                    lines[at] = "x";
+                break;
+            }
+        }
+        return lines;
+    }
+
+    /// Joins `lines`, ending the last one with a newline if `finalNewline`.
+    std::string contentsOf(const std::vector<std::string>& lines, bool finalNewline) {
+        std::string contents;
+        for (std::size_t index = 0; index < lines.size(); ++index) {
+            contents += lines[index];
+            if (index + 1 < lines.size() || finalNewline)
+                contents += '\n';
+        }
+        return contents;
+    }
+
+    bool writeFile(const std::string& path, const std::string& contents) {
+        std::error_code error;
+        llvm::raw_fd_ostream stream(path, error, llvm::sys::fs::F_None);
+        if (error)
+            return false;
+        stream << contents;
+        return true;
+    }
+}  // namespace
+
+/// Checks `writeUnifiedDiff` against `git apply`: for randomized edit scripts,
+/// applying the diff of two versions of a file to the first must yield the
+/// second. Versions with and without a final newline are mixed, and lines are
+/// drawn from a small alphabet so the diff has to pick among many matches.
+int main() {
+    llvm::SmallString<256> directory;
+    if (llvm::sys::fs::createUniqueDirectory("unified-diff-test", directory)) {
+        llvm::errs() << "could not create a temporary directory\n";
+        return EXIT_FAILURE;
+    }
+    llvm::SmallString<256> file(directory);
+    llvm::sys::path::append(file, "file.txt");
+    llvm::SmallString<256> patch(directory);
+    llvm::sys::path::append(patch, "file.patch");
+    const std::string apply = "cd '" + directory.str().str() + "' && git apply file.patch";
+
+    std::mt19937 random(20181019);
+    unsigned failures = 0;
+    for (unsigned round = 0; round < kRounds; ++round) {
+        const auto beforeLines = randomLines(random, 30);
+        const auto before = contentsOf(beforeLines, random() % 4 != 0);
+        const auto after = contentsOf(edited(random, beforeLines), random() % 4 != 0);
+
+        std::string diff;
+        {
+            llvm::raw_string_ostream out(diff);
+            tidy::writeUnifiedDiff(out, "file.txt", before, after);
+        }
+        if (before == after) {
+            if (!diff.empty()) {
+                llvm::errs() << "round " << round << ": diff of equal contents\n";
+                ++failures;
+            }
+            continue;
+        }
+
+        std::string applied;
+        if (writeFile(file.str().str(), before) && writeFile(patch.str().str(), diff) && std::system(apply.c_str()) == 0) {
+            if (auto buffer = llvm::MemoryBuffer::getFile(file.str()))
+                applied = (*buffer)->getBuffer().str();
+        }
+        if (applied != after) {
+            llvm::errs() << "round " << round << ": git apply did not reproduce the new contents\n"
+                         << "--- before\n" << before << "\n--- after\n" << after << "\n--- diff\n" << diff;
+            ++failures;
+        }
+    }
+
+    llvm::sys::fs::remove(file.str());
+    llvm::sys::fs::remove(patch.str());
+    llvm::sys::fs::remove(directory.str());
+    if (failures > 0) {
+        llvm::errs() << failures << " of " << kRounds << " rounds failed\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+// Project includes
+#include "misra-tidy/common/caching-file-system.hpp"
+#include "misra-tidy/common/routines.hpp"
+#include "../macro-expand-exe/file-watcher.hpp"
+
+// LLVM includes
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Standard includes
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <system_error>
+
+namespace {
+    unsigned failures = 0;
+
+    void check(bool condition, const std::string& message) {
+        if (!condition) {
+            llvm::errs() << message << '\n';
+            ++failures;
+        }
+    }
+
+    bool writeFile(const std::string& path, const std::string& contents) {
+        std::error_code error;
+        llvm::raw_fd_ostream stream(path, error, llvm::sys::fs::F_None);
+        if (error)
+            return false;
+        stream << contents;
+        return true;
+    }
+
+    /// Returns what a translation unit in `fileSystem` reads as `path`, or
+    /// null if it cannot.
+    std::unique_ptr<llvm::MemoryBuffer> read(tidy::CachingFileSystem& fileSystem, const std::string& path) {
+        auto file = fileSystem.openFileForRead(path);
+        if (!file)
+            return nullptr;
+        auto buffer = (*file)->getBuffer(path, -1, /*RequiresNullTerminator=*/true, /*IsVolatile=*/false);
+        if (!buffer)
+            return nullptr;
+        return std::move(*buffer);
+    }
+}  // namespace
+
+/// Checks what `macro-expand -watch` does between rounds: a header included
+/// as `../common/x.h` is edited, next to an include graph saved the way the
+/// watching process saves it. The watcher must report the header but not the
+/// graph, and invalidating the reported path must reach the header as the
+/// translation unit spelled it, while the buffer it already holds stays valid.
+int main() {
+    llvm::SmallString<256> directory;
+    if (llvm::sys::fs::createUniqueDirectory("watch-test", directory)) {
+        llvm::errs() << "could not create a temporary directory\n";
+        return EXIT_FAILURE;
+    }
+    const auto root = tidy::Routines::makeAbsolute(directory.str().str());
+    const auto source = root + "/src";
+    const auto common = root + "/common";
+    const auto header = common + "/x.h";
+    const auto graph = common + "/include-graph.json";
+    llvm::sys::fs::create_directories(source);
+    llvm::sys::fs::create_directories(common);
+    if (!writeFile(header, "#define X 1\n")) {
+        llvm::errs() << "could not write " << header << '\n';
+        return EXIT_FAILURE;
+    }
+
+    auto cache = std::make_shared<tidy::FileCache>();
+    tidy::CachingFileSystem fileSystem(cache, source);
+    auto before = read(fileSystem, "../common/x.h");
+    check(before && before->getBuffer() == "#define X 1\n", "the header was not read through ../");
+
+    tidy::FileWatcher watcher;
+    watcher.watchDirectoryOf(header);
+    watcher.ignore(graph);
+    check(writeFile(graph + ".tmp", "{}") && !llvm::sys::fs::rename(graph + ".tmp", graph),
+        "could not save the include graph");
+    check(writeFile(header, "#define X 2\n"), "could not edit the header");
+
+    const auto changes = watcher.wait(std::chrono::milliseconds(100));
+    const auto reported = [&changes](const std::string& path) {
+        return std::find(changes.paths.begin(), changes.paths.end(), path) != changes.paths.end();
+    };
+    check(reported(header), "the edited header was not reported");
+    check(!reported(graph) && !reported(graph + ".tmp"), "saving the include graph was reported");
+    for (const auto& path : changes.paths)
+        cache->invalidate(tidy::Routines::makeAbsolute(path));
+
+    const auto after = read(fileSystem, "../common/x.h");
+    check(after && after->getBuffer() == "#define X 2\n", "the header reached through ../ is stale");
+    check(before && before->getBuffer() == "#define X 1\n", "the buffer read before the edit changed");
+
+    llvm::sys::fs::remove(header);
+    llvm::sys::fs::remove(graph);
+    llvm::sys::fs::remove(common);
+    llvm::sys::fs::remove(source);
+    llvm::sys::fs::remove(root);
+    return failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
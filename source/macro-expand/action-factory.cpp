@@ -9,12 +9,12 @@
 
 namespace tidy {
 namespace MacroExpand {
-ActionFactory::ActionFactory(Query& query)
-: _query(query) {
+ActionFactory::ActionFactory(Query& query, UnitRecords& records)
+: _query(query), _records(records) {
 }
 
 clang::FrontendAction* ActionFactory::create() {
-  return new MacroExpand::Action(_query);
+  return new MacroExpand::Action(_query, _records);
 }
 
 }  // namespace MacroExpand
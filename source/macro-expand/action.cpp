@@ -1,16 +1,20 @@
 
 // Project includes
 #include "misra-tidy/common/offset.hpp"
+#include "misra-tidy/common/probes.hpp"
 #include "misra-tidy/common/routines.hpp"
 #include "misra-tidy/macro-expand/query.hpp"
 #include "misra-tidy/macro-expand/action.hpp"
 #include "misra-tidy/macro-expand/macro-search.hpp"
 
 // Clang includes
+#include <clang/Basic/Diagnostic.h>
 #include <clang/Basic/FileManager.h>
 #include <clang/Basic/SourceManager.h>
 #include <clang/Basic/TokenKinds.h>
 #include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/Utils.h>
+#include <clang/Lex/PreprocessorOptions.h>
 #include <clang/Lex/Lexer.h>
 #include <clang/Lex/PPCallbacks.h>
 #include <clang/Lex/Preprocessor.h>
@@ -20,11 +24,15 @@
 #include <llvm/ADT/StringRef.h>
 #include <llvm/ADT/StringSet.h>
 #include <llvm/ADT/Twine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
 
 // Standard includes
 #include <cassert>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <system_error>
 #include <utility>
 
 
@@ -32,15 +40,31 @@ namespace tidy {
     namespace MacroExpand {
 
         bool Action::BeginInvocation(clang::CompilerInstance& Compiler) {
-            _query._rewriter.emplace( Compiler.getSourceManager(), Compiler.getLangOpts() );
+            _staleTokenCache.reset();
+            if (_query._tokenCache && !Compiler.getFrontendOpts().Inputs.empty()) {
+                auto entry = _query._tokenCache->entryFor(
+                    Compiler.getFrontendOpts().Inputs[0].getFile(),
+                    Compiler.getInvocation().getModuleHash());
+                if (_query._tokenCache->isValid(entry)) {
+                    Compiler.getPreprocessorOpts().TokenCache = entry.tokens;
+                    ++_records.statistics.tokenCacheHits;
+                }
+                else {
+                    _temporaryTokens = entry.tokens + ".tmp";
+                    _staleTokenCache = std::move(entry);
+                    ++_records.statistics.tokenCacheMisses;
+                }
+            }
             return true;
         }
 
-        bool Action::BeginSourceFileAction(clang::CompilerInstance& compiler, llvm::StringRef) {
+        bool Action::BeginSourceFileAction(clang::CompilerInstance& compiler, llvm::StringRef filename) {
+            TIDY_PROBE1(tu__begin, filename.str().c_str());
+
             /// Given a `clang::CompilerInstance`, installs appropriate preprocessor
             /// hooks for macro search (looking for macros with the name of the target
             /// function) with the `CompilerInstance`.
-            auto hooks = std::make_unique<MacroSearch>(compiler, _query);
+            auto hooks = std::make_unique<MacroSearch>(compiler, _query, _records);
             compiler.getPreprocessor().SetSuppressIncludeNotFoundError(true);
             compiler.getPreprocessor().addPPCallbacks(std::move(hooks));
 
@@ -48,9 +72,57 @@ namespace tidy {
             return true;
         }
 
+        void Action::ExecuteAction() {
+            if (!_staleTokenCache) {
+                clang::PreprocessOnlyAction::ExecuteAction();
+                return;
+            }
+
+            std::error_code error;
+            llvm::raw_fd_ostream tokens(_temporaryTokens, error, llvm::sys::fs::F_None);
+            if (error) {
+                _staleTokenCache.reset();
+                clang::PreprocessOnlyAction::ExecuteAction();
+                return;
+            }
+
+            /// Writing the PTH file preprocesses the whole translation unit with our
+            /// hooks installed, so a cold run still only preprocesses once.
+            clang::CacheTokens(getCompilerInstance().getPreprocessor(), &tokens);
+        }
+
         void Action::EndSourceFileAction() {
-            if (_query.options.wantsRewritten && _query._rewriter)
-                _query._rewriter->overwriteChangedFiles();
+            const bool failed = getCompilerInstance().getDiagnostics().hasErrorOccurred();
+            ++_records.statistics.translationUnits;
+            if (failed)
+                ++_records.statistics.failedTranslationUnits;
+
+            if (_staleTokenCache) {
+                /// Nothing is rewritten until all translation units are done, so the
+                /// manifest describes the files the tokens were lexed from and
+                /// rewritten files invalidate the entry.
+                if (failed)
+                    llvm::sys::fs::remove(_temporaryTokens);
+                else
+                    _query._tokenCache->commit(*_staleTokenCache, _temporaryTokens, getCompilerInstance().getSourceManager());
+                _staleTokenCache.reset();
+            }
+
+            if (_query._includeGraph) {
+                /// Failed translation units may not have read all their files;
+                /// forgetting them makes the next incremental run retry them.
+                const auto mainFile = Routines::makeAbsolute(getCurrentFile().str());
+                if (failed)
+                    _query._includeGraph->forget(mainFile);
+                else
+                    _query._includeGraph->record(mainFile, getCompilerInstance().getSourceManager());
+            }
+
+            TIDY_PROBE2(tu__end, getCurrentFile().str().c_str(), failed);
+            std::lock_guard<std::mutex> lock(_query._mutex);
+            _query.statistics += _records.statistics;
+            if (_query.progress)
+                _query.progress(_query.statistics);
         }
 
     }  // namespace MacroExpand
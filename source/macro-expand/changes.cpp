@@ -0,0 +1,125 @@
+// Project includes
+#include "misra-tidy/common/routines.hpp"
+#include "misra-tidy/macro-expand/changes.hpp"
+
+// LLVM includes
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Program.h>
+
+// Standard includes
+#include <algorithm>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace tidy {
+    namespace {
+        /// Runs git with `arguments` and returns its standard output.
+        std::string runGit(const std::vector<std::string>& arguments) {
+            const auto git = llvm::sys::findProgramByName("git");
+            if (!git)
+                throw Routines::ErrorCode{ "could not find git" };
+
+            llvm::SmallString<128> outputFile;
+            if (llvm::sys::fs::createTemporaryFile("macro-expand-git", "txt", outputFile))
+                throw Routines::ErrorCode{ "could not create a temporary file for git" };
+
+            std::vector<const char*> argv{ git->c_str() };
+            for (const auto& argument : arguments)
+                argv.push_back(argument.c_str());
+            argv.push_back(nullptr);
+            const llvm::StringRef output(outputFile);
+            const llvm::StringRef* redirects[] = { nullptr, &output, nullptr };
+
+            std::string error;
+            const auto status = llvm::sys::ExecuteAndWait(*git, argv.data(), nullptr, redirects, 0, 0, &error);
+            auto buffer = llvm::MemoryBuffer::getFile(outputFile);
+            llvm::sys::fs::remove(outputFile);
+            if (status != 0 || !buffer)
+                throw Routines::ErrorCode{ "git " + arguments.front() + " failed" + (error.empty() ? "" : ": " + error) };
+            return (*buffer)->getBuffer().str();
+        }
+
+        /// Returns the path of a `---`/`+++` line of a diff, made absolute
+        /// against `root`, or an empty string for `/dev/null`.
+        std::string pathOf(llvm::StringRef header, llvm::StringRef root) {
+            auto path = header.drop_front(4).rtrim("\r");
+            if (path == "/dev/null")
+                return {};
+            path = path.drop_front(2);  // The "a/" or "b/" prefix.
+            llvm::SmallString<256> absolute(root);
+            llvm::sys::path::append(absolute, path);
+            return Routines::makeAbsolute(absolute.str().str());
+        }
+    }  // namespace
+
+    Changes Changes::fromGit(const std::string& revision) {
+        llvm::SmallVector<llvm::StringRef, 2> lines;
+        const auto directories = runGit({ "rev-parse", "--show-toplevel", "--git-dir" });
+        llvm::StringRef(directories).trim().split(lines, '\n');
+        if (lines.size() != 2)
+            throw Routines::ErrorCode{ "not inside a git work tree" };
+
+        const auto diff = runGit({ "diff", "--unified=0", "--no-color", "--no-ext-diff",
+            "--src-prefix=a/", "--dst-prefix=b/", revision, "--" });
+        auto changes = fromDiff(diff, lines[0].trim());
+        changes.gitDirectory = Routines::makeAbsolute(lines[1].trim().str());
+        return changes;
+    }
+
+    Changes Changes::fromDiff(llvm::StringRef diff, llvm::StringRef root) {
+        Changes changes;
+        std::vector<LineRange>* current = nullptr;
+        while (!diff.empty()) {
+            llvm::StringRef line;
+            std::tie(line, diff) = diff.split('\n');
+            if (line.startswith("--- ")) {
+                const auto path = pathOf(line, root);
+                if (!path.empty())
+                    changes._files[path];
+            }
+            else if (line.startswith("+++ ")) {
+                const auto path = pathOf(line, root);
+                current = path.empty() ? nullptr : &changes._files[path];
+            }
+            else if (line.startswith("@@ ") && current) {
+                // @@ -a[,b] +c[,d] @@: d lines starting at c are new.
+                auto added = line.drop_front(3).split(' ').second.split(' ').first;
+                if (!added.consume_front("+"))
+                    continue;
+                const auto numbers = added.split(',');
+                unsigned start = 0;
+                unsigned count = 1;
+                if (numbers.first.getAsInteger(10, start) ||
+                    (!numbers.second.empty() && numbers.second.getAsInteger(10, count)))
+                    continue;
+                if (count > 0)
+                    current->emplace_back(start, start + count - 1);
+            }
+        }
+        for (auto& file : changes._files)
+            std::sort(file.second.begin(), file.second.end());
+        return changes;
+    }
+
+    Changes Changes::fromFiles(const std::vector<std::string>& paths) {
+        Changes changes;
+        for (const auto& path : paths)
+            changes._files[path];
+        return changes;
+    }
+
+    bool Changes::containsFile(llvm::StringRef path) const {
+        return _files.count(path) > 0;
+    }
+
+    const std::vector<Changes::LineRange>* Changes::linesOf(llvm::StringRef path) const {
+        const auto file = _files.find(path);
+        return file == _files.end() ? nullptr : &file->second;
+    }
+
+}  // namespace tidy
@@ -0,0 +1,91 @@
+// Project includes
+#include "misra-tidy/macro-expand/definition-table.hpp"
+
+// Clang includes
+#include <clang/Basic/FileManager.h>
+#include <clang/Basic/SourceManager.h>
+
+// LLVM includes
+#include <llvm/ADT/Hashing.h>
+
+// Standard includes
+#include <cstddef>
+#include <mutex>
+#include <utility>
+
+namespace tidy {
+
+    constexpr unsigned DefinitionTable::kInvalid;
+
+    unsigned DefinitionTable::idOf(clang::SourceLocation location,
+        const clang::SourceManager& sourceManager) {
+        const auto decomposed = sourceManager.getDecomposedSpellingLoc(location);
+        const auto* entry = sourceManager.getFileEntryForID(decomposed.first);
+        if (!entry)
+            return kInvalid;
+        const Key key{ entry->getUniqueID(), decomposed.second };
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            const auto found = _ids.find(key);
+            if (found != _ids.end())
+                return found->second;
+        }
+
+        // Only new definitions pay for their `Location`.
+        Location resolved(location, sourceManager);
+        std::lock_guard<std::mutex> lock(_mutex);
+        const auto found = _ids.find(key);
+        if (found != _ids.end())
+            return found->second;
+        const auto added = _addedIds.find(resolved);
+        if (added != _addedIds.end())
+            return _ids[key] = added->second;
+        const auto id = static_cast<unsigned>(_locations.size());
+        _ids.emplace(key, id);
+        _locations.push_back(std::move(resolved));
+        _used.resize(_locations.size());
+        return id;
+    }
+
+    unsigned DefinitionTable::add(Location location) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const auto inserted = _addedIds.emplace(location, static_cast<unsigned>(_locations.size()));
+        if (inserted.second) {
+            _locations.push_back(std::move(location));
+            _used.resize(_locations.size());
+        }
+        return inserted.first->second;
+    }
+
+    void DefinitionTable::markUsed(const llvm::BitVector& used) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (used.size() > _used.size())
+            _used.resize(used.size());
+        _used |= used;
+    }
+
+    void DefinitionTable::markUsed(unsigned id) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _used.set(id);
+    }
+
+    bool DefinitionTable::isUsed(unsigned id) const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _used.test(id);
+    }
+
+    std::size_t DefinitionTable::size() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _locations.size();
+    }
+
+    Location DefinitionTable::locationOf(unsigned id) const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _locations[id];
+    }
+
+    std::size_t DefinitionTable::KeyHash::operator()(const Key& key) const {
+        return llvm::hash_combine(key.file.getDevice(), key.file.getFile(), key.offset);
+    }
+
+}  // namespace tidy
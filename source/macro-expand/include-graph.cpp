@@ -0,0 +1,141 @@
+// Project includes
+#include "misra-tidy/common/routines.hpp"
+#include "misra-tidy/macro-expand/changes.hpp"
+#include "misra-tidy/macro-expand/include-graph.hpp"
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// Clang includes
+#include <clang/Basic/FileManager.h>
+#include <clang/Basic/SourceManager.h>
+
+// LLVM includes
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Standard includes
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace tidy {
+
+    IncludeGraph::IncludeGraph(std::string filename)
+        : _filename(std::move(filename)) {
+        if (_filename.empty())
+            return;
+        auto buffer = llvm::MemoryBuffer::getFile(_filename);
+        if (!buffer)
+            return;
+        // A hand-edited or partially migrated graph is as good as none.
+        try {
+            const auto graph = nlohmann::json::parse((*buffer)->getBuffer().str());
+            for (const auto& file : graph.at("files"))
+                _indexOf(file.get<std::string>());
+            const auto& translationUnits = graph.at("translationUnits");
+            for (auto it = translationUnits.begin(); it != translationUnits.end(); ++it) {
+                auto& indices = _translationUnits[it.key()];
+                for (const auto& index : it.value()) {
+                    const auto value = index.get<std::size_t>();
+                    if (value < _files.size())
+                        indices.push_back(value);
+                }
+            }
+        }
+        catch (const std::exception&) {
+            _files.clear();
+            _fileIndices.clear();
+            _translationUnits.clear();
+        }
+    }
+
+    bool IncludeGraph::isAffected(const std::string& mainFile, const Changes& changes) const {
+        if (changes.containsFile(mainFile))
+            return true;
+        std::lock_guard<std::mutex> lock(_mutex);
+        const auto unit = _translationUnits.find(mainFile);
+        if (unit == _translationUnits.end())
+            return true;
+        for (const auto index : unit->second) {
+            if (changes.containsFile(_files[index]))
+                return true;
+        }
+        return false;
+    }
+
+    void IncludeGraph::record(const std::string& mainFile,
+        const clang::SourceManager& sourceManager) {
+        std::vector<std::string> files;
+        for (auto it = sourceManager.fileinfo_begin(); it != sourceManager.fileinfo_end(); ++it)
+            files.push_back(Routines::makeAbsolute(it->first->getName()));
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto& indices = _translationUnits[mainFile];
+        indices.clear();
+        for (const auto& file : files)
+            indices.push_back(_indexOf(file));
+    }
+
+    llvm::StringSet<> IncludeGraph::filesReadBy(const std::vector<std::string>& mainFiles) const {
+        llvm::StringSet<> files;
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (const auto& mainFile : mainFiles) {
+            const auto unit = _translationUnits.find(mainFile);
+            if (unit == _translationUnits.end())
+                continue;
+            for (const auto index : unit->second)
+                files.insert(_files[index]);
+        }
+        return files;
+    }
+
+    std::vector<std::string> IncludeGraph::files() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _files;
+    }
+
+    void IncludeGraph::forget(const std::string& mainFile) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _translationUnits.erase(mainFile);
+    }
+
+    void IncludeGraph::save() const {
+        if (_filename.empty())
+            return;
+        nlohmann::json graph;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            graph["files"] = _files;
+            graph["translationUnits"] = nlohmann::json::object();
+            for (const auto& unit : _translationUnits)
+                graph["translationUnits"][unit.first()] = unit.second;
+        }
+
+        const auto temporary = _filename + ".tmp";
+        {
+            std::error_code error;
+            llvm::raw_fd_ostream stream(temporary, error, llvm::sys::fs::F_Text);
+            if (error) {
+                llvm::errs() << "Could not write " << temporary << ": " << error.message() << '\n';
+                return;
+            }
+            stream << graph.dump();
+        }
+        if (const auto error = llvm::sys::fs::rename(temporary, _filename))
+            llvm::errs() << "Could not write " << _filename << ": " << error.message() << '\n';
+    }
+
+    std::size_t IncludeGraph::_indexOf(llvm::StringRef file) {
+        const auto inserted = _fileIndices.insert(std::make_pair(file, _files.size()));
+        if (inserted.second)
+            _files.push_back(file.str());
+        return inserted.first->second;
+    }
+
+}  // namespace tidy
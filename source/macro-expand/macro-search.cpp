@@ -3,12 +3,14 @@
 #include "misra-tidy/common/call-data.hpp"
 #include "misra-tidy/common/definition-data.hpp"
 #include "misra-tidy/common/location.hpp"
+#include "misra-tidy/common/probes.hpp"
 #include "misra-tidy/common/range.hpp"
 #include "misra-tidy/common/routines.hpp"
 #include "misra-tidy/macro-expand/query.hpp"
 #include "misra-tidy/macro-expand/macro-search.hpp"
 
 // Clang includes
+#include <clang/Basic/FileManager.h>
 #include <clang/Basic/IdentifierTable.h>
 #include <clang/Basic/SourceLocation.h>
 #include <clang/Basic/TokenKinds.h>
@@ -19,8 +21,10 @@
 #include <clang/Lex/Token.h>
 #include <clang/Lex/TokenLexer.h>
 #include <clang/Rewrite/Core/Rewriter.h>
+#include <clang/Tooling/Core/Replacement.h>
 
 // LLVM includes
+#include <llvm/ADT/BitVector.h>
 #include <llvm/ADT/Optional.h>
 #include <llvm/ADT/SmallString.h>
 #include <llvm/ADT/StringMap.h>
@@ -28,8 +32,10 @@
 #include <llvm/ADT/Twine.h>
 
 // System includes
+#include <algorithm>
 #include <cassert>
 #include <iterator>
+#include <mutex>
 #include <string>
 #include <type_traits>
 
@@ -42,17 +48,6 @@ namespace tidy {
     namespace MacroExpand {
         namespace {
 
-            /// Gets the raw source text of a macro definition.
-            std::string getDefinitionText(const clang::MacroInfo& info,
-                clang::SourceManager& sourceManager,
-                const clang::LangOptions& languageOptions) {
-                // Using the rewriter (without actually rewriting) is honestly the only way I
-                // found to get at the raw source text in a macro-safe way.
-                const auto start = info.tokens_begin()->getLocation();
-                const auto end = std::prev(info.tokens_end())->getEndLoc();
-                return Routines::getSourceText({ start, end }, sourceManager, languageOptions);
-            }
-
             /// Rewrites a macro argument use inside a macro in case the parameter it maps
             /// to was found to be preceded with a `#` stringification operator. It
             /// basically quotes it.
@@ -79,11 +74,13 @@ namespace tidy {
         }  // namespace
 
         MacroSearch::MacroSearch(clang::CompilerInstance& compiler,
-            Query& query)
+            Query& query,
+            UnitRecords& records)
             : _sourceManager(compiler.getSourceManager())
             , _languageOptions(compiler.getLangOpts())
             , _preprocessor(compiler.getPreprocessor())
-            , _query(query) {
+            , _query(query)
+            , _records(records) {
         }
 
         void MacroSearch::MacroExpands(const clang::Token& macroNameToken,
@@ -95,22 +92,49 @@ namespace tidy {
             const auto& loc = info->getDefinitionLoc();
             const auto macroname = _getSpelling(macroNameToken);
             auto defContext = _defCountMap.find(loc);
-            if (defContext == _defCountMap.end())
+            if (defContext == _defCountMap.end()) {
+                TIDY_PROBE3(macro__reject, macroname.c_str(),
+                    _sourceManager.getFilename(range.getBegin()).str().c_str(),
+                    Probes::kUntracked);
                 return; // This macro definition we don't care about
+            }
             ++defContext->second._count;
 
             if (_sourceManager.isInSystemHeader(loc) ||              //don't expand macros defined in a system header
                 _sourceManager.isInSystemHeader(range.getBegin()) || //don't expand macros in headers that are in System headers
                 !clang::Rewriter::isRewritable(range.getBegin())     //don't expand macros in headers that we cannot write to
-                )
+                ) {
+                TIDY_PROBE3(macro__reject, macroname.c_str(),
+                    _sourceManager.getFilename(range.getBegin()).str().c_str(),
+                    Probes::kNotRewritable);
                 return;
-            auto original = getDefinitionText(*info, _sourceManager, _languageOptions);
-
-            const auto mapping = _createParameterMap(*info, *arguments);
-            if (info->isObjectLike() && !_query.options.wantsObjectExpand)
+            }
+            if (!_isAccepted(range.getBegin())) {
+                TIDY_PROBE3(macro__reject, macroname.c_str(),
+                    _sourceManager.getFilename(range.getBegin()).str().c_str(),
+                    Probes::kFiltered);
+                return;
+            }
+            if (_query._changes && _query.options.wantsChangedLinesOnly && !_isChanged(range)) {
+                TIDY_PROBE3(macro__reject, macroname.c_str(),
+                    _sourceManager.getFilename(range.getBegin()).str().c_str(),
+                    Probes::kUnchanged);
                 return;
-            if (info->isFunctionLike() && !_query.options.wantsFcnCallExpand)
+            }
+
+            if ((info->isObjectLike() && !_query.options.wantsObjectExpand) ||
+                (info->isFunctionLike() && !_query.options.wantsFcnCallExpand)) {
+                TIDY_PROBE3(macro__reject, macroname.c_str(),
+                    _sourceManager.getFilename(range.getBegin()).str().c_str(),
+                    Probes::kKindDisabled);
                 return;
+            }
+
+            auto original = Routines::getDefinitionText(*info, _sourceManager, _languageOptions);
+            const auto mapping = _createParameterMap(*info, *arguments);
+            TIDY_PROBE3(macro__accept, macroname.c_str(),
+                _sourceManager.getFilename(range.getBegin()).str().c_str(),
+                _sourceManager.getSpellingLineNumber(range.getBegin()));
             std::string text = _rewriteMacro(*info, mapping);
 
             Location location(loc, _sourceManager);
@@ -120,14 +144,16 @@ namespace tidy {
                 const auto length = macroNameToken.getLength() - 1;
                 range.setEnd(range.getBegin().getLocWithOffset(length));
             }
-            _query._rewriter->ReplaceText(range, { text });
+            auto replacement = _replacementOf(clang::CharSourceRange::getTokenRange(range), text, /*removesLine=*/false);
             Query::IndividualMacroInfo lmacro;
             lmacro.call.emplace(Range{ range, _sourceManager });
             lmacro.definition.emplace(std::move(location),
                 std::move(original),
                 std::move(text),
                 /*isMacro=*/true);
-            _query._macroInvocations.push_back(std::move(lmacro));
+            lmacro.configuration = _records.configuration;
+            _records.expansions.push_back({ std::move(lmacro), std::move(replacement) });
+            ++_records.statistics.expansions;
 
             //now update the defCountMap
             --defContext->second._count;
@@ -139,10 +165,20 @@ namespace tidy {
             //Return early if this is not a macro we can remove
             if (macroDirective->getMacroInfo()->isBuiltinMacro() || // For built-in macros example. __LINE__
                 loc.isInvalid() ||                                  // For macros defined on the command line.
-                _sourceManager.isInSystemHeader(loc)                // don't expand macros defined in a system header
+                _sourceManager.isInSystemHeader(loc) ||             // don't expand macros defined in a system header
+                !_isAccepted(loc)                                   // don't touch macros defined in filtered files
                 )
                 return;
             if (macroNameTok.getKind() == clang::tok::identifier) {
+                // Filtered macros never enter `_defCountMap`, so `MacroExpands`
+                // drops them on its first lookup.
+                if (_query._nameFilter &&
+                    !_query._nameFilter->accepts(macroNameTok.getIdentifierInfo()->getName()))
+                    return;
+                TIDY_PROBE3(macro__defined,
+                    macroNameTok.getIdentifierInfo()->getName().str().c_str(),
+                    _sourceManager.getFilename(loc).str().c_str(),
+                    _sourceManager.getSpellingLineNumber(loc));
                 MacroContext ctx = { *macroDirective->getMacroInfo(), llvm::Optional<const clang::SourceRange>(), 0 };
                 _defCountMap.insert({ loc, std::move(ctx) });
             }
@@ -157,9 +193,13 @@ namespace tidy {
             const auto& loc = defMacroInfo->getDefinitionLoc();
             //Return early if this is not a macro we can remove
             if (loc.isInvalid() || defMacroInfo->isBuiltinMacro() || // For macros defined on the command line.
-                _sourceManager.isInSystemHeader(loc)                 //don't expand macros defined in a system header
+                _sourceManager.isInSystemHeader(loc) ||              //don't expand macros defined in a system header
+                !_isAccepted(loc)                                    //not tracked by MacroDefined either
                 )
                 return;
+            if (_query._nameFilter &&
+                !_query._nameFilter->accepts(macroNameTok.getIdentifierInfo()->getName()))
+                return;
 
             assert(defMacroInfo && loc.isValid() && "Could not find a #def for some #undef");
             auto defCtx = _defCountMap.find(loc);
@@ -172,35 +212,59 @@ namespace tidy {
         {
             if (!_query.options.wantsUnusedRemoved)
                 return;
+
+            // A main file preprocessed in several configurations only loses a
+            // definition once no configuration uses it, i.e. in the last one.
+            // Its configurations may be preprocessed at the same time, so they
+            // take turns.
+            std::unique_lock<std::mutex> lock(_query._mutex);
+            auto pending = _query._pendingConfigurations.end();
+            if (const auto* mainFile = _sourceManager.getFileEntryForID(_sourceManager.getMainFileID()))
+                pending = _query._pendingConfigurations.find(Routines::makeAbsolute(mainFile->getName()));
+            const bool hasPendingConfigurations = pending != _query._pendingConfigurations.end();
+            const bool isLastConfiguration = !hasPendingConfigurations || pending->second == 1;
+            if (!hasPendingConfigurations)
+                lock.unlock();
+
+            // The header definitions this translation unit used, by ID, merged
+            // into the query's table in one go at the end.
+            llvm::BitVector usedHeaderDefinitions;
+            const bool isJournaled = !_query.options.journalDirectory.empty();
             for (const auto& ctxIt : _defCountMap)
             {               
                 if (!clang::Rewriter::isRewritable(ctxIt.first)          //don't remove macros in headers we cannot write to
                     || ctxIt.second._defMacro.isUsedForHeaderGuard()     //don't remove macros from header guards
                     )
                     continue;
-                Query::MacroDefCountMap::iterator macroDefIterator;
                 if (!_sourceManager.isWrittenInMainFile(ctxIt.first)  ///\note:we're only focusing on removing macros from source files not header files
                     )
                 {
-                    const auto key = Location{ ctxIt.first,_sourceManager };
-                    macroDefIterator = _query._macroDefinitionsInHeaders.find(key);
-                    if (macroDefIterator == _query._macroDefinitionsInHeaders.end() ||
-                        macroDefIterator->second.first < ctxIt.second._count) {
-                        std::pair<size_t, llvm::Optional<Location>> val(ctxIt.second._count, llvm::Optional<Location>());
-                        auto emplaceResult = _query._macroDefinitionsInHeaders.emplace(std::make_pair(key, val));
-                        macroDefIterator = emplaceResult.first;
+                    // Used if any translation unit (or configuration) uses it.
+                    const auto id = _query._headerDefinitions.idOf(ctxIt.first, _sourceManager);
+                    if (id != DefinitionTable::kInvalid && ctxIt.second._count > 0) {
+                        if (id >= usedHeaderDefinitions.size())
+                            usedHeaderDefinitions.resize(id + 1);
+                        usedHeaderDefinitions.set(id);
                     }
+                    if (id != DefinitionTable::kInvalid && isJournaled)
+                        _records.headerDefinitions.emplace_back(id, ctxIt.second._count > 0);
                     continue;
-                } 
-                if (ctxIt.second._count == 0)
+                }
+                auto count = ctxIt.second._count;
+                if (hasPendingConfigurations) {
+                    Location location{ ctxIt.first, _sourceManager };
+                    if (isJournaled)
+                        _records.mainFileDefinitionUses.emplace_back(location, count);
+                    auto& uses = _query._mainFileDefinitionUses[location];
+                    uses = std::max(uses, count);
+                    if (!isLastConfiguration)
+                        continue;
+                    count = uses;
+                }
+                if (count == 0)
                 {
-                    clang::Rewriter::RewriteOptions rwo;
-                    rwo.RemoveLineIfEmpty = true;
-                    auto decomposedMacroStart = _sourceManager.getDecomposedLoc(ctxIt.first);
-                    bool Invalid = false;
-                    auto hashLoc = _sourceManager.translateLineCol(decomposedMacroStart.first, _sourceManager.getLineNumber(decomposedMacroStart.first, decomposedMacroStart.second, &Invalid), 1);
-                    clang::SourceRange macroRange = { hashLoc, ctxIt.second._defMacro.getDefinitionEndLoc() };
-                    _query._rewriter->RemoveText(macroRange, rwo);
+                    _recordRemoval(ctxIt.first, ctxIt.second._defMacro.getDefinitionEndLoc());
+                    ++_records.statistics.definitionsRemoved;
                     if (ctxIt.second._undefRange)
                     {
                         const auto& loc = ctxIt.second._undefRange->getBegin();
@@ -209,17 +273,15 @@ namespace tidy {
                             continue;
                         if (!_sourceManager.isWrittenInMainFile(loc)   //we're only focusing on removing macros from source files not header files
                             )
-                        {
-                            macroDefIterator->second.second = Location{ loc,_sourceManager };
                             continue;
-                        }
-                        decomposedMacroStart = _sourceManager.getDecomposedLoc(loc);
-                        hashLoc = _sourceManager.translateLineCol(decomposedMacroStart.first, _sourceManager.getLineNumber(decomposedMacroStart.first, decomposedMacroStart.second, &Invalid), 1);
-                        macroRange = { hashLoc, ctxIt.second._undefRange->getEnd() };
-                        _query._rewriter->RemoveText(macroRange, rwo);
+                        _recordRemoval(loc, ctxIt.second._undefRange->getEnd());
                     }
                 }
             }
+
+            _query._headerDefinitions.markUsed(usedHeaderDefinitions);
+            if (hasPendingConfigurations && --pending->second == 0)
+                _query._pendingConfigurations.erase(pending);
         }
 
         std::string MacroSearch::_rewriteMacro(const clang::MacroInfo& info,
@@ -304,5 +366,74 @@ namespace tidy {
             return clang::Lexer::getSpelling(token, _sourceManager, _languageOptions);
         }
 
+        bool MacroSearch::_isAccepted(clang::SourceLocation location) {
+            if (!_query._pathFilter)
+                return true;
+            const auto file = _sourceManager.getFileID(_sourceManager.getSpellingLoc(location));
+            const auto cached = _acceptedFiles.find(file);
+            if (cached != _acceptedFiles.end())
+                return cached->second;
+
+            bool accepted = true;
+            if (const auto* entry = _sourceManager.getFileEntryForID(file))
+                accepted = _query._pathFilter->accepts(Routines::makeAbsolute(entry->getName()));
+            _acceptedFiles[file] = accepted;
+            return accepted;
+        }
+
+        clang::tooling::Replacement MacroSearch::_replacementOf(clang::CharSourceRange range,
+            llvm::StringRef text,
+            bool removesLine) const {
+            const clang::tooling::Replacement replacement(_sourceManager, range, text, _languageOptions);
+            auto length = replacement.getLength();
+            if (removesLine) {
+                // Like `RemoveLineIfEmpty`: the range starts the line, so the line
+                // is empty if only whitespace follows it.
+                const auto file = _sourceManager.getFileID(_sourceManager.getSpellingLoc(range.getBegin()));
+                const auto buffer = _sourceManager.getBufferData(file);
+                auto end = replacement.getOffset() + length;
+                while (end < buffer.size() && (buffer[end] == ' ' || buffer[end] == '\t'))
+                    ++end;
+                if (end < buffer.size() && buffer[end] == '\r')
+                    ++end;
+                if (end < buffer.size() && buffer[end] == '\n')
+                    length = end + 1 - replacement.getOffset();
+            }
+            return clang::tooling::Replacement(Routines::makeAbsolute(replacement.getFilePath()),
+                replacement.getOffset(), length, replacement.getReplacementText());
+        }
+
+        void MacroSearch::_recordRemoval(clang::SourceLocation location,
+            clang::SourceLocation end) {
+            const auto decomposed = _sourceManager.getDecomposedLoc(location);
+            bool invalid = false;
+            const auto hashLoc = _sourceManager.translateLineCol(decomposed.first,
+                _sourceManager.getLineNumber(decomposed.first, decomposed.second, &invalid), 1);
+            _records.removals.push_back(
+                _replacementOf(clang::CharSourceRange::getTokenRange(hashLoc, end), "", /*removesLine=*/true));
+        }
+
+        bool MacroSearch::_isChanged(clang::SourceRange range) {
+            const auto begin = _sourceManager.getSpellingLoc(range.getBegin());
+            const auto file = _sourceManager.getFileID(begin);
+            auto cached = _changedLines.find(file);
+            if (cached == _changedLines.end()) {
+                const std::vector<Changes::LineRange>* lines = nullptr;
+                if (const auto* entry = _sourceManager.getFileEntryForID(file))
+                    lines = _query._changes->linesOf(Routines::makeAbsolute(entry->getName()));
+                cached = _changedLines.insert(std::make_pair(file, lines)).first;
+            }
+            if (!cached->second)
+                return false;
+
+            const auto first = _sourceManager.getSpellingLineNumber(begin);
+            const auto last = std::max(first, _sourceManager.getSpellingLineNumber(range.getEnd()));
+            for (const auto& lines : *cached->second) {
+                if (lines.first <= last && first <= lines.second)
+                    return true;
+            }
+            return false;
+        }
+
     }  // namespace MacroExpand
 }  // namespace tidy
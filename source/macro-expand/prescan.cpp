@@ -0,0 +1,344 @@
+// Project includes
+#include "misra-tidy/common/caching-file-system.hpp"
+#include "misra-tidy/macro-expand/prescan.hpp"
+
+// Clang includes
+#include <clang/Frontend/CompilerInvocation.h>
+#include <clang/Lex/HeaderSearchOptions.h>
+#include <clang/Lex/PreprocessorOptions.h>
+
+// LLVM includes
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+
+// Standard includes
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tidy {
+    namespace MacroExpand {
+        namespace {
+            /// A directory of the include search path.
+            struct SearchDirectory {
+                std::string path;
+                bool isSystem;
+            };
+
+            /// The include search path of an invocation, in lookup order.
+            struct SearchPath {
+                std::vector<SearchDirectory> directories;
+
+                /// The first directory searched for `<...>` includes.
+                std::size_t firstAngled = 0;
+
+                /// Whether the search path uses something we cannot follow.
+                bool isOpaque = false;
+            };
+
+            /// Returns `path` made absolute, keyed like the `FileCache` keys it.
+            std::string absolute(llvm::StringRef path) {
+                llvm::SmallString<256> result(path);
+                llvm::sys::fs::make_absolute(result);
+                llvm::sys::path::remove_dots(result, /*remove_dot_dot=*/false);
+                return result.str();
+            }
+
+            SearchPath searchPathOf(const clang::HeaderSearchOptions& options) {
+                // clang searches the groups in this order, whatever the order of
+                // the options on the command line.
+                std::vector<const clang::HeaderSearchOptions::Entry*> entries;
+                for (const auto& entry : options.UserEntries)
+                    entries.push_back(&entry);
+                std::stable_sort(entries.begin(), entries.end(),
+                    [](const clang::HeaderSearchOptions::Entry* first,
+                        const clang::HeaderSearchOptions::Entry* second) {
+                        return first->Group < second->Group;
+                    });
+
+                SearchPath searchPath;
+                for (const auto* entry : entries) {
+                    if (entry->IsFramework || entry->Group == clang::frontend::IndexHeaderMap ||
+                        llvm::StringRef(entry->Path).endswith(".hmap")) {
+                        searchPath.isOpaque = true;
+                        break;
+                    }
+                    std::string path = entry->Path;
+                    if (!entry->IgnoreSysRoot && options.Sysroot != "/" &&
+                        llvm::sys::path::is_absolute(path))
+                        path = options.Sysroot + path;
+                    if (entry->Group == clang::frontend::Quoted)
+                        ++searchPath.firstAngled;
+                    searchPath.directories.push_back(
+                        { absolute(path), entry->Group >= clang::frontend::System });
+                }
+                if (options.UseBuiltinIncludes) {
+                    llvm::SmallString<256> builtin(options.ResourceDir);
+                    llvm::sys::path::append(builtin, "include");
+                    searchPath.directories.push_back({ absolute(builtin), /*isSystem=*/true });
+                }
+                return searchPath;
+            }
+
+            bool isHorizontalSpace(char character) {
+                return character == ' ' || character == '\t' || character == '\f' ||
+                    character == '\v';
+            }
+
+            bool isIdentifierCharacter(char character) {
+                return std::isalnum(static_cast<unsigned char>(character)) || character == '_';
+            }
+
+            /// Returns the end of the logical line `it` is on, i.e. the first
+            /// newline not escaped by a backslash.
+            const char* endOfLogicalLine(const char* it, const char* end) {
+                while (it != end) {
+                    const auto* newline = static_cast<const char*>(std::memchr(it, '\n', end - it));
+                    if (!newline)
+                        return end;
+                    const char* last = newline;
+                    if (last != it && last[-1] == '\r')
+                        --last;
+                    if (last == it || last[-1] != '\\')
+                        return newline;
+                    it = newline + 1;
+                }
+                return end;
+            }
+
+            /// Returns true if the `#` at `hash` may start a directive, i.e. only
+            /// whitespace (or the end of a block comment) precedes it on its line.
+            bool startsDirective(const char* begin, const char* hash) {
+                const char* it = hash;
+                while (it != begin && isHorizontalSpace(it[-1]))
+                    --it;
+                if (it == begin || it[-1] == '\n' || it[-1] == '\r')
+                    return true;
+                return it - begin >= 2 && it[-1] == '/' && it[-2] == '*';
+            }
+        }  // namespace
+
+        Prescan::Prescan(std::shared_ptr<FileCache> fileCache)
+            : _fileCache(std::move(fileCache)) {
+        }
+
+        bool Prescan::mayDefineMacros(const clang::CompilerInvocation& invocation,
+            const std::string& mainFile) {
+            bool definesMacros = false;
+            if (!_forEachInClosure(invocation, mainFile, [&definesMacros](Scan& scan) {
+                    return definesMacros = scan.definesMacros;
+                }))
+                return true;
+            return definesMacros;
+        }
+
+        void Prescan::collectDefinitions(const clang::CompilerInvocation& invocation,
+            const std::string& mainFile) {
+            if (!_forEachInClosure(invocation, mainFile, [this](Scan& scan) {
+                    for (const auto& name : scan.definedNames)
+                        _definedNames.insert(name);
+                    return false;
+                }))
+                _hasAllDefinitions = false;
+        }
+
+        void Prescan::buildNameFilter() {
+            if (!_hasAllDefinitions)
+                return;
+            _nameFilter.emplace(_definedNames.size());
+            for (const auto& name : _definedNames)
+                _nameFilter->insert(name.getKey());
+        }
+
+        bool Prescan::mayUseMacros(const clang::CompilerInvocation& invocation,
+            const std::string& mainFile) {
+            if (!_nameFilter)
+                return true;
+            bool usesMacros = false;
+            if (!_forEachInClosure(invocation, mainFile, [this, &usesMacros](Scan& scan) {
+                    if (!scan.usesMacros)
+                        scan.usesMacros = _usesMacros(scan);
+                    return usesMacros = *scan.usesMacros;
+                }))
+                return true;
+            return usesMacros;
+        }
+
+        bool Prescan::_forEachInClosure(const clang::CompilerInvocation& invocation,
+            const std::string& mainFile,
+            llvm::function_ref<bool(Scan&)> visit) {
+            const auto& preprocessorOptions = invocation.getPreprocessorOpts();
+            if (!preprocessorOptions.Includes.empty() ||
+                !preprocessorOptions.MacroIncludes.empty() ||
+                !preprocessorOptions.ImplicitPCHInclude.empty() ||
+                !preprocessorOptions.ImplicitPTHInclude.empty())
+                return false;
+
+            const auto searchPath = searchPathOf(invocation.getHeaderSearchOpts());
+            if (searchPath.isOpaque)
+                return false;
+
+            std::vector<std::string> pending{ mainFile };
+            llvm::StringSet<> visited;
+            visited.insert(mainFile);
+            while (!pending.empty()) {
+                const auto file = std::move(pending.back());
+                pending.pop_back();
+                auto* scan = _scan(file);
+                if (!scan || scan->isOpaque)
+                    return false;
+                if (visit(*scan))
+                    return true;
+
+                for (const auto& include : scan->includes) {
+                    const auto& name = include.first;
+                    std::string found;
+                    bool isSystem = false;
+                    if (llvm::sys::path::is_absolute(name)) {
+                        found = absolute(name);
+                    }
+                    else {
+                        std::vector<SearchDirectory> candidates;
+                        if (!include.second)
+                            candidates.push_back({ llvm::sys::path::parent_path(file).str(), false });
+                        candidates.insert(candidates.end(),
+                            searchPath.directories.begin() +
+                                (include.second ? searchPath.firstAngled : 0),
+                            searchPath.directories.end());
+                        for (const auto& directory : candidates) {
+                            llvm::SmallString<256> candidate(directory.path);
+                            llvm::sys::path::append(candidate, name);
+                            llvm::sys::path::remove_dots(candidate, /*remove_dot_dot=*/false);
+                            const auto status = _fileCache->status(candidate.str());
+                            if (status && !status->isDirectory()) {
+                                found = candidate.str();
+                                isSystem = directory.isSystem;
+                                break;
+                            }
+                        }
+                    }
+
+                    // Not found: clang will complain, or knows better than we do.
+                    if (found.empty())
+                        return false;
+                    if (!isSystem && visited.insert(found).second)
+                        pending.push_back(std::move(found));
+                }
+            }
+            return true;
+        }
+
+        Prescan::Scan* Prescan::_scan(const std::string& path) {
+            auto contents = _fileCache->contents(path);
+            if (!contents)
+                return nullptr;
+            auto cached = _scans.find(path);
+            if (cached != _scans.end() && cached->second.contents == *contents)
+                return &cached->second;
+
+            Scan scan;
+            scan.contents = *contents;
+            const auto text = scan.contents->getBuffer();
+            const char* const begin = text.begin();
+            const char* const end = text.end();
+            for (const char* it = begin;
+                 (it = static_cast<const char*>(std::memchr(it, '#', end - it))) != nullptr;) {
+                if (!startsDirective(begin, it)) {
+                    ++it;
+                    continue;
+                }
+                ++it;
+                while (it != end && isHorizontalSpace(*it))
+                    ++it;
+                const char* word = it;
+                while (it != end && isIdentifierCharacter(*it))
+                    ++it;
+                const llvm::StringRef directive(word, it - word);
+
+                if (directive == "define") {
+                    scan.definesMacros = true;
+                    while (it != end && isHorizontalSpace(*it))
+                        ++it;
+                    const char* name = it;
+                    while (it != end && isIdentifierCharacter(*it))
+                        ++it;
+                    if (it != name)
+                        scan.definedNames.emplace_back(name, it);
+                    continue;
+                }
+                if (directive == "include_next") {
+                    scan.isOpaque = true;
+                    continue;
+                }
+                if (directive != "include" && directive != "import")
+                    continue;
+
+                while (it != end && isHorizontalSpace(*it))
+                    ++it;
+                const char close = it == end ? '\0' : *it == '"' ? '"' : *it == '<' ? '>' : '\0';
+                if (close == '\0') {
+                    scan.isOpaque = true;  // A computed include.
+                    continue;
+                }
+                const char* name = ++it;
+                while (it != end && *it != close && *it != '\n')
+                    ++it;
+                if (it == end || *it != close) {
+                    scan.isOpaque = true;
+                    continue;
+                }
+                scan.includes.emplace_back(std::string(name, it), close == '>');
+            }
+
+            auto& entry = _scans[path];
+            entry = std::move(scan);
+            return &entry;
+        }
+
+        bool Prescan::_usesMacros(const Scan& scan) const {
+            const auto text = scan.contents->getBuffer();
+            const char* const begin = text.begin();
+            const char* const end = text.end();
+            const char* it = begin;
+            while (it != end) {
+                const char character = *it;
+                if (character == '#' && startsDirective(begin, it)) {
+                    ++it;
+                    while (it != end && isHorizontalSpace(*it))
+                        ++it;
+                    const char* directive = it;
+                    while (it != end && isIdentifierCharacter(*it))
+                        ++it;
+                    const llvm::StringRef name(directive, it - directive);
+                    // Only these directives expand macros; skip the (logical)
+                    // line of any other, e.g. the name of a `#define` or `#ifndef`.
+                    if (name != "if" && name != "elif" && name != "include" &&
+                        name != "import" && name != "line" && name != "pragma")
+                        it = endOfLogicalLine(it, end);
+                    continue;
+                }
+                if (!isIdentifierCharacter(character)) {
+                    ++it;
+                    continue;
+                }
+                const char* identifier = it;
+                while (it != end && isIdentifierCharacter(*it))
+                    ++it;
+                // Skip numbers, including suffixes like the `ULL` of `1ULL`.
+                if (std::isdigit(static_cast<unsigned char>(character)))
+                    continue;
+                if (_nameFilter->mayContain(llvm::StringRef(identifier, it - identifier)))
+                    return true;
+            }
+            return false;
+        }
+
+    }  // namespace MacroExpand
+}  // namespace tidy
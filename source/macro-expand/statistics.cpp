@@ -0,0 +1,117 @@
+// Project includes
+#include "misra-tidy/macro-expand/statistics.hpp"
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// Standard includes
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+
+namespace tidy {
+    Statistics::Timer::Timer(Statistics& statistics, const char* phase)
+        : _statistics(statistics)
+        , _phase(phase)
+        , _start(std::chrono::steady_clock::now()) {
+        _statistics.openPhases.emplace(_phase, _start);
+    }
+
+    Statistics::Timer::~Timer() {
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - _start;
+        _statistics.phaseSeconds[_phase] += elapsed.count();
+        const auto open = _statistics.openPhases.find(_phase);
+        if (open != _statistics.openPhases.end() && open->second == _start)
+            _statistics.openPhases.erase(open);
+    }
+
+    std::map<std::string, double> Statistics::phaseSecondsSoFar() const {
+        auto seconds = phaseSeconds;
+        const auto now = std::chrono::steady_clock::now();
+        for (const auto& phase : openPhases) {
+            const std::chrono::duration<double> elapsed = now - phase.second;
+            seconds[phase.first] += elapsed.count();
+        }
+        return seconds;
+    }
+
+    nlohmann::json Statistics::toJson() const {
+        // clang-format off
+        nlohmann::json json = {
+            {"translationUnits", translationUnits},
+            {"failedTranslationUnits", failedTranslationUnits},
+            {"translationUnitsSkipped", translationUnitsSkipped},
+            {"translationUnitsUnchanged", translationUnitsUnchanged},
+            {"translationUnitsReplayed", translationUnitsReplayed},
+            {"expansions", expansions},
+            {"definitionsRemoved", definitionsRemoved},
+            {"editsDropped", editsDropped},
+            {"bytesWritten", bytesWritten},
+            {"tokenCacheHits", tokenCacheHits},
+            {"tokenCacheMisses", tokenCacheMisses},
+            {"compileCommandGroups", compileCommandGroups},
+            {"duplicateCommandsSkipped", duplicateCommandsSkipped},
+            {"multiConfigurationUnits", multiConfigurationUnits},
+            {"missingFilesPreloaded", missingFilesPreloaded},
+            {"peakResidentBytes", peakResidentBytes}
+        };
+        // clang-format on
+
+        for (const auto& phase : phaseSeconds) {
+            json["phases"][phase.first] = phase.second;
+        }
+
+        return json;
+    }
+
+    Statistics Statistics::fromJson(const nlohmann::json& json) {
+        const std::size_t none = 0;
+        Statistics statistics;
+        statistics.translationUnits = json.value("translationUnits", none);
+        statistics.failedTranslationUnits = json.value("failedTranslationUnits", none);
+        statistics.translationUnitsSkipped = json.value("translationUnitsSkipped", none);
+        statistics.translationUnitsUnchanged = json.value("translationUnitsUnchanged", none);
+        statistics.translationUnitsReplayed = json.value("translationUnitsReplayed", none);
+        statistics.expansions = json.value("expansions", none);
+        statistics.definitionsRemoved = json.value("definitionsRemoved", none);
+        statistics.editsDropped = json.value("editsDropped", none);
+        statistics.bytesWritten = json.value("bytesWritten", none);
+        statistics.tokenCacheHits = json.value("tokenCacheHits", none);
+        statistics.tokenCacheMisses = json.value("tokenCacheMisses", none);
+        statistics.compileCommandGroups = json.value("compileCommandGroups", none);
+        statistics.duplicateCommandsSkipped = json.value("duplicateCommandsSkipped", none);
+        statistics.multiConfigurationUnits = json.value("multiConfigurationUnits", none);
+        statistics.missingFilesPreloaded = json.value("missingFilesPreloaded", none);
+        statistics.peakResidentBytes = json.value("peakResidentBytes", none);
+        if (json.count("phases")) {
+            for (auto phase = json["phases"].begin(); phase != json["phases"].end(); ++phase)
+                statistics.phaseSeconds[phase.key()] = phase.value().get<double>();
+        }
+        return statistics;
+    }
+
+    Statistics& Statistics::operator+=(const Statistics& other) {
+        translationUnits += other.translationUnits;
+        failedTranslationUnits += other.failedTranslationUnits;
+        translationUnitsSkipped += other.translationUnitsSkipped;
+        translationUnitsUnchanged += other.translationUnitsUnchanged;
+        translationUnitsReplayed += other.translationUnitsReplayed;
+        expansions += other.expansions;
+        definitionsRemoved += other.definitionsRemoved;
+        editsDropped += other.editsDropped;
+        tokenCacheHits += other.tokenCacheHits;
+        tokenCacheMisses += other.tokenCacheMisses;
+        compileCommandGroups += other.compileCommandGroups;
+        duplicateCommandsSkipped += other.duplicateCommandsSkipped;
+        multiConfigurationUnits += other.multiConfigurationUnits;
+        missingFilesPreloaded += other.missingFilesPreloaded;
+        bytesWritten += other.bytesWritten;
+        peakResidentBytes = std::max(peakResidentBytes, other.peakResidentBytes);
+        for (const auto& phase : other.phaseSeconds)
+            phaseSeconds[phase.first] += phase.second;
+        return *this;
+    }
+
+}  // namespace tidy
@@ -0,0 +1,152 @@
+// Project includes
+#include "misra-tidy/common/routines.hpp"
+#include "misra-tidy/macro-expand/token-cache.hpp"
+
+// Third party includes
+#include <third-party/json.hpp>
+
+// Clang includes
+#include <clang/Basic/FileManager.h>
+#include <clang/Basic/SourceManager.h>
+
+// LLVM includes
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/Twine.h>
+#include <llvm/Support/Chrono.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+// Standard includes
+#include <chrono>
+#include <ctime>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace tidy {
+    namespace {
+        /// Returns the hex MD5 digest of `data`.
+        std::string md5Of(llvm::StringRef data) {
+            llvm::MD5 hash;
+            hash.update(data);
+            llvm::MD5::MD5Result result;
+            hash.final(result);
+            llvm::SmallString<32> hex;
+            llvm::MD5::stringifyResult(result, hex);
+            return hex.str();
+        }
+    }  // namespace
+
+    TokenCache::TokenCache(std::string directory)
+        : _directory(std::move(directory)) {
+        llvm::sys::fs::create_directories(_directory);
+    }
+
+    TokenCache::Entry TokenCache::entryFor(llvm::StringRef mainFile,
+        llvm::StringRef languageHash) const {
+        const auto key = md5Of((mainFile + "\n" + languageHash).str());
+        llvm::SmallString<256> path(_directory);
+        llvm::sys::path::append(path, key);
+        return { (path + ".pth").str(), (path + ".json").str() };
+    }
+
+    bool TokenCache::isValid(const Entry& entry) {
+        if (!llvm::sys::fs::exists(entry.tokens))
+            return false;
+        auto buffer = llvm::MemoryBuffer::getFile(entry.manifest);
+        if (!buffer)
+            return false;
+
+        // A manifest cut off or garbled by a crashed run is just a miss.
+        try {
+            const auto manifest = nlohmann::json::parse((*buffer)->getBuffer().str());
+            const auto written = manifest.at("written").get<long long>();
+            for (const auto& file : manifest.at("files")) {
+                // Files modified in the same second the manifest was written may have
+                // changed without their timestamp showing it, so always hash those.
+                const auto modificationTime = file.at("mtime").get<long long>();
+                if (!_isUnchanged(file.at("path").get<std::string>(),
+                        file.at("size").get<unsigned long long>(),
+                        modificationTime < written ? modificationTime : -1,
+                        file.at("md5").get<std::string>()))
+                    return false;
+            }
+        }
+        catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+
+    bool TokenCache::_isUnchanged(const std::string& filename,
+        unsigned long long size,
+        long long modificationTime,
+        const std::string& md5) {
+        const auto key = md5 + filename;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            const auto checked = _checkedFiles.find(key);
+            if (checked != _checkedFiles.end())
+                return checked->getValue();
+        }
+
+        bool unchanged = false;
+        llvm::sys::fs::file_status status;
+        if (!llvm::sys::fs::status(filename, status)) {
+            const auto mtime = static_cast<long long>(
+                llvm::sys::toTimeT(status.getLastModificationTime()));
+            if (status.getSize() == size && mtime == modificationTime) {
+                unchanged = true;
+            }
+            else if (auto buffer = llvm::MemoryBuffer::getFile(filename)) {
+                unchanged = md5Of((*buffer)->getBuffer()) == md5;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _checkedFiles[key] = unchanged;
+        return unchanged;
+    }
+
+    void TokenCache::commit(const Entry& entry,
+        const std::string& temporaryTokens,
+        const clang::SourceManager& sourceManager) {
+        nlohmann::json manifest;
+        manifest["written"] = static_cast<long long>(std::time(nullptr));
+        manifest["files"] = nlohmann::json::array();
+        for (auto it = sourceManager.fileinfo_begin(); it != sourceManager.fileinfo_end(); ++it) {
+            const auto* buffer = it->second->getRawBuffer();
+            if (!buffer)
+                continue;  // Never read, so not in the token cache either.
+            // clang-format off
+            manifest["files"].push_back({
+                {"path", Routines::makeAbsolute(it->first->getName())},
+                {"size", static_cast<unsigned long long>(it->first->getSize())},
+                {"mtime", static_cast<long long>(it->first->getModificationTime())},
+                {"md5", md5Of(buffer->getBuffer())}
+            });
+            // clang-format on
+        }
+
+        // Without a manifest an entry is invalid, so drop the old one before
+        // replacing the tokens and only write the new one once they are in place.
+        llvm::sys::fs::remove(entry.manifest);
+        if (llvm::sys::fs::rename(temporaryTokens, entry.tokens))
+            return;
+        const auto temporaryManifest = entry.manifest + ".tmp";
+        {
+            std::error_code error;
+            llvm::raw_fd_ostream stream(temporaryManifest, error, llvm::sys::fs::F_Text);
+            if (error)
+                return;
+            stream << manifest.dump();
+        }
+        llvm::sys::fs::rename(temporaryManifest, entry.manifest);
+    }
+
+}  // namespace tidy